@@ -0,0 +1,26 @@
+/*
+Allocation of large frames on huge pages
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE (1 << 21)
+
+void *alloc_frame(size_t size)
+{
+#ifdef MADV_HUGEPAGE
+	void *frame;
+	if (size >= HUGE_PAGE && !posix_memalign(&frame, HUGE_PAGE, size)) {
+		madvise(frame, size, MADV_HUGEPAGE);
+		return frame;
+	}
+#endif
+	return malloc(size);
+}
@@ -0,0 +1,160 @@
+/*
+Adaptive binary range coding
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "bytes.h"
+
+#define ARITH_BITS 15
+#define ARITH_ONE (1 << ARITH_BITS)
+#define ARITH_RATE 5
+#define ARITH_TOP (1 << 24)
+
+struct arith_reader {
+	struct bytes_reader *bytes;
+	uint32_t range;
+	uint32_t code;
+	int err;
+};
+
+struct arith_writer {
+	struct bytes_writer *bytes;
+	uint64_t low;
+	uint32_t range;
+	int cache;
+	int pending;
+	int first;
+};
+
+void arith_contexts(uint16_t *probs, int num)
+{
+	for (int i = 0; i < num; ++i)
+		probs[i] = ARITH_ONE / 2;
+}
+
+struct arith_reader *arith_reader(struct bytes_reader *bytes)
+{
+	struct arith_reader *arith = malloc(sizeof(struct arith_reader));
+	arith->bytes = bytes;
+	arith->range = 0xffffffff;
+	arith->code = 0;
+	arith->err = 0;
+	for (int i = 0; i < 4; ++i) {
+		int b = get_byte(bytes);
+		if (b < 0) {
+			arith->err = b;
+			break;
+		}
+		arith->code = (arith->code << 8) | b;
+	}
+	return arith;
+}
+
+struct arith_writer *arith_writer(struct bytes_writer *bytes)
+{
+	struct arith_writer *arith = malloc(sizeof(struct arith_writer));
+	arith->bytes = bytes;
+	arith->low = 0;
+	arith->range = 0xffffffff;
+	arith->cache = 0;
+	arith->pending = 1;
+	arith->first = 1;
+	return arith;
+}
+
+long long arith_count(struct arith_writer *arith)
+{
+	return bytes_count(arith->bytes) + arith->pending - arith->first + 4;
+}
+
+int arith_shift(struct arith_writer *arith)
+{
+	if ((uint32_t)arith->low < 0xff000000 || arith->low >> 32) {
+		int carry = arith->low >> 32;
+		for (int b = arith->cache; arith->pending; b = 0xff, --arith->pending) {
+			if (arith->first) {
+				arith->first = 0;
+				continue;
+			}
+			int ret = put_byte(arith->bytes, b + carry);
+			if (ret)
+				return ret;
+		}
+		arith->cache = (arith->low >> 24) & 255;
+	}
+	arith->pending += 1;
+	arith->low = (arith->low & 0x00ffffff) << 8;
+	return 0;
+}
+
+int arith_flush(struct arith_writer *arith)
+{
+	for (int i = 0; i < 5; ++i) {
+		int ret = arith_shift(arith);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+void delete_arith_reader(struct arith_reader *arith)
+{
+	free(arith);
+}
+
+void delete_arith_writer(struct arith_writer *arith)
+{
+	free(arith);
+}
+
+int put_arith(struct arith_writer *arith, int bit, uint16_t *prob)
+{
+	uint32_t bound = (arith->range >> ARITH_BITS) * *prob;
+	if (bit) {
+		arith->low += bound;
+		arith->range -= bound;
+		*prob -= *prob >> ARITH_RATE;
+	} else {
+		arith->range = bound;
+		*prob += (ARITH_ONE - *prob) >> ARITH_RATE;
+	}
+	while (arith->range < ARITH_TOP) {
+		arith->range <<= 8;
+		int ret = arith_shift(arith);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+int get_arith(struct arith_reader *arith, uint16_t *prob)
+{
+	if (arith->err)
+		return arith->err;
+	int bit;
+	uint32_t bound = (arith->range >> ARITH_BITS) * *prob;
+	if (arith->code < bound) {
+		arith->range = bound;
+		*prob += (ARITH_ONE - *prob) >> ARITH_RATE;
+		bit = 0;
+	} else {
+		arith->code -= bound;
+		arith->range -= bound;
+		*prob -= *prob >> ARITH_RATE;
+		bit = 1;
+	}
+	while (arith->range < ARITH_TOP) {
+		int b = get_byte(arith->bytes);
+		if (b < 0) {
+			arith->err = b;
+			break;
+		}
+		arith->range <<= 8;
+		arith->code = (arith->code << 8) | b;
+	}
+	return bit;
+}
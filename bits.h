@@ -38,11 +38,27 @@ struct bits_writer *bits_writer(struct bytes_writer *bytes)
 	return bits;
 }
 
-int bits_count(struct bits_writer *bits)
+long long bits_count(struct bits_writer *bits)
 {
 	return bits->cnt + 8 * bytes_count(bits->bytes);
 }
 
+int bits_flush(struct bits_writer *bits)
+{
+	if (!bits->cnt)
+		return 0;
+	int b = bits->acc;
+	bits->acc = 0;
+	bits->cnt = 0;
+	return put_byte(bits->bytes, b);
+}
+
+void bits_align(struct bits_reader *bits)
+{
+	bits->acc = 0;
+	bits->cnt = 0;
+}
+
 void close_bits_reader(struct bits_reader *bits)
 {
 	free(bits);
@@ -8,17 +8,29 @@ Copyright 2024 Ahmet Inan <xdsopl@gmail.com>
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define BYTES_BUFFER (1 << 20)
+#define BYTES_SUM 2166136261u
+#define BYTES_PRIME 16777619u
 
 struct bytes_reader {
 	FILE *file;
 	char *name;
+	uint32_t sum;
 };
 
 struct bytes_writer {
 	FILE *file;
 	char *name;
-	int cnt;
-	int cap;
+	long long cnt;
+	long long cap;
+	unsigned char *buffer, *pending;
+	int fill, size, err, busy, quit, thread;
+	pthread_t writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
 };
 
 struct bytes_reader *bytes_reader(char *name)
@@ -34,10 +46,11 @@ struct bytes_reader *bytes_reader(char *name)
 	struct bytes_reader *bytes = malloc(sizeof(struct bytes_reader));
 	bytes->file = file;
 	bytes->name = name;
+	bytes->sum = BYTES_SUM;
 	return bytes;
 }
 
-struct bytes_writer *bytes_writer(char *name, int capacity)
+struct bytes_writer *bytes_writer(char *name, long long capacity)
 {
 	const char *fname = "/dev/stdout";
 	if (name[0] != '-' || name[1])
@@ -52,14 +65,97 @@ struct bytes_writer *bytes_writer(char *name, int capacity)
 	bytes->name = name;
 	bytes->cnt = 0;
 	bytes->cap = capacity;
+	bytes->buffer = malloc(BYTES_BUFFER);
+	bytes->pending = 0;
+	bytes->fill = 0;
+	bytes->size = 0;
+	bytes->err = 0;
+	bytes->busy = 0;
+	bytes->quit = 0;
+	bytes->thread = 0;
 	return bytes;
 }
 
-int bytes_count(struct bytes_writer *bytes)
+void *bytes_writer_loop(void *data)
+{
+	struct bytes_writer *bytes = data;
+	pthread_mutex_lock(&bytes->mutex);
+	while (1) {
+		while (!bytes->busy && !bytes->quit)
+			pthread_cond_wait(&bytes->cond, &bytes->mutex);
+		if (!bytes->busy)
+			break;
+		pthread_mutex_unlock(&bytes->mutex);
+		int err = bytes->size != (int)fwrite(bytes->pending, 1, bytes->size, bytes->file);
+		pthread_mutex_lock(&bytes->mutex);
+		bytes->err |= err;
+		bytes->busy = 0;
+		pthread_cond_signal(&bytes->cond);
+	}
+	pthread_mutex_unlock(&bytes->mutex);
+	return 0;
+}
+
+int bytes_writer_thread(struct bytes_writer *bytes)
+{
+	bytes->pending = malloc(BYTES_BUFFER);
+	pthread_mutex_init(&bytes->mutex, 0);
+	pthread_cond_init(&bytes->cond, 0);
+	if (pthread_create(&bytes->writer, 0, bytes_writer_loop, bytes)) {
+		fprintf(stderr, "could not start writer thread for file \"%s\"\n", bytes->name);
+		return -1;
+	}
+	bytes->thread = 1;
+	return 0;
+}
+
+int bytes_flush(struct bytes_writer *bytes)
+{
+	int err;
+	if (!bytes->thread) {
+		bytes->err |= bytes->fill != (int)fwrite(bytes->buffer, 1, bytes->fill, bytes->file);
+		bytes->fill = 0;
+		err = bytes->err;
+	} else {
+		pthread_mutex_lock(&bytes->mutex);
+		while (bytes->busy)
+			pthread_cond_wait(&bytes->cond, &bytes->mutex);
+		unsigned char *swap = bytes->pending;
+		bytes->pending = bytes->buffer;
+		bytes->buffer = swap;
+		bytes->size = bytes->fill;
+		bytes->busy = bytes->fill > 0;
+		bytes->fill = 0;
+		err = bytes->err;
+		pthread_cond_signal(&bytes->cond);
+		pthread_mutex_unlock(&bytes->mutex);
+	}
+	if (err) {
+		fprintf(stderr, "could not write to file \"%s\"\n", bytes->name);
+		return -1;
+	}
+	return 0;
+}
+
+long long bytes_count(struct bytes_writer *bytes)
 {
 	return bytes->cnt;
 }
 
+long bytes_tell(struct bytes_reader *bytes)
+{
+	return ftell(bytes->file);
+}
+
+int bytes_seek(struct bytes_reader *bytes, long offset, int whence)
+{
+	if (fseek(bytes->file, offset, whence)) {
+		fprintf(stderr, "could not seek in file \"%s\"\n", bytes->name);
+		return -1;
+	}
+	return 0;
+}
+
 void close_bytes_reader(struct bytes_reader *bytes)
 {
 	fclose(bytes->file);
@@ -68,7 +164,21 @@ void close_bytes_reader(struct bytes_reader *bytes)
 
 void close_bytes_writer(struct bytes_writer *bytes)
 {
+	bytes_flush(bytes);
+	if (bytes->thread) {
+		pthread_mutex_lock(&bytes->mutex);
+		bytes->quit = 1;
+		pthread_cond_signal(&bytes->cond);
+		pthread_mutex_unlock(&bytes->mutex);
+		pthread_join(bytes->writer, 0);
+		pthread_mutex_destroy(&bytes->mutex);
+		pthread_cond_destroy(&bytes->cond);
+		if (bytes->err)
+			fprintf(stderr, "could not write to file \"%s\"\n", bytes->name);
+	}
 	fclose(bytes->file);
+	free(bytes->buffer);
+	free(bytes->pending);
 	free(bytes);
 }
 
@@ -76,15 +186,14 @@ int put_byte(struct bytes_writer *bytes, int b)
 {
 	if (bytes->cap > 0 && bytes->cnt >= bytes->cap)
 		return -2;
-	if (EOF == fputc(b & 255, bytes->file)) {
-		fprintf(stderr, "could not write to file \"%s\"\n", bytes->name);
+	if (bytes->fill == BYTES_BUFFER && bytes_flush(bytes))
 		return -1;
-	}
+	bytes->buffer[bytes->fill++] = b;
 	bytes->cnt += 1;
 	return 0;
 }
 
-int write_bytes(struct bytes_writer *bytes, int b, int n)
+int write_bytes(struct bytes_writer *bytes, long long b, int n)
 {
 	for (int i = 0; i < 8 * n; i += 8) {
 		int ret = put_byte(bytes, b >> i);
@@ -101,19 +210,42 @@ int get_byte(struct bytes_reader *bytes)
 		fprintf(stderr, "reached end of file \"%s\"\n", bytes->name);
 		return -1;
 	}
+	bytes->sum = (bytes->sum ^ b) * BYTES_PRIME;
 	return b;
 }
 
+int bytes_skip(struct bytes_reader *bytes, long long count)
+{
+	for (long long i = 0; i < count; ++i) {
+		int b = get_byte(bytes);
+		if (b < 0)
+			return b;
+	}
+	return 0;
+}
+
 int read_bytes(struct bytes_reader *bytes, int *b, int n)
 {
-	int a = 0;
+	unsigned a = 0;
 	for (int i = 0; i < 8 * n; i += 8) {
 		int b = get_byte(bytes);
 		if (b < 0)
 			return b;
-		a |= b << i;
+		a |= (unsigned)b << i;
 	}
 	*b = a;
 	return 0;
 }
 
+int read_long_bytes(struct bytes_reader *bytes, long long *b, int n)
+{
+	unsigned long long a = 0;
+	for (int i = 0; i < 8 * n; i += 8) {
+		int b = get_byte(bytes);
+		if (b < 0)
+			return b;
+		a |= (unsigned long long)b << i;
+	}
+	*b = a;
+	return 0;
+}
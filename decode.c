@@ -4,139 +4,92 @@ Decoder for lossless image compression based on the discrete wavelet transformat
 Copyright 2021 Ahmet Inan <xdsopl@gmail.com>
 */
 
-#include "hilbert.h"
-#include "cdf53.h"
-#include "utils.h"
+#define _DEFAULT_SOURCE
+#include "decoder.h"
 #include "pnm.h"
-#include "rle.h"
-#include "vli.h"
-#include "bits.h"
 #include "bytes.h"
 
-void transformation(int *out, int *in, int N0, int W, int H, int SO, int SI, int SW, int CH)
+int decode_sequence(struct bytes_reader *bytes, char *name, int frame)
 {
-	int W2 = (W + 1) / 2, H2 = (H + 1) / 2;
-	if (W2 >= N0 && H2 >= N0)
-		transformation(out, in, N0, W2, H2, SO, SI, SW, CH);
-	icdf53(out, in, H, SO * SW, SI * SW, W * CH);
-	for (int j = 0; j < H; ++j)
-		for (int i = 0; i < W * CH; ++i)
-			in[(SW * j + i) * SI] = out[(SW * j + i) * SO];
-	for (int j = 0; j < H; ++j) {
-		icdf53(out + SO * SW * j, in + SI * SW * j, W, SO * CH, SI * CH, CH);
-		for (int i = 0; i < W * CH; ++i)
-			in[(SW * j + i) * SI] = out[(SW * j + i) * SO];
-	}
-}
-
-void reconstruction(int *output, int **input, int *missing, int *widths, int *heights, int *lengths, int levels, int channels)
-{
-	int index = 0;
-	int width = widths[levels];
-	for (int y = 0; y < heights[0]; ++y) {
-		for (int x = 0; x < widths[0]; ++x) {
-			for (int chan = 0; chan < channels; ++chan) {
-				int v = input[chan][index];
-				output[channels * (width * y + x) + chan] = v;
-			}
-			++index;
-		}
-	}
-	for (int l = 0; l < levels; ++l) {
-		for (int i = 0; i < lengths[l + 1] * lengths[l + 1]; ++i) {
-			struct position pos = hilbert(lengths[l + 1], i);
-			if ((pos.x >= widths[l] || pos.y >= heights[l]) && pos.x < widths[l + 1] && pos.y < heights[l + 1]) {
-				for (int chan = 0; chan < channels; ++chan) {
-					int v = input[chan][index];
-					int m = missing[chan * 16 + l] - 2;
-					if (m >= 0) {
-						int bias = 1 << m;
-						if (v < 0)
-							v -= bias;
-						else if (v > 0)
-							v += bias;
-					}
-					output[channels * (width * pos.y + pos.x) + chan] = v;
-				}
-				++index;
-			}
+	int first = 0, last = -1;
+	if (frame >= 0) {
+		long long index;
+		int count;
+		if (bytes_seek(bytes, -8, SEEK_END) || read_long_bytes(bytes, &index, 8) || bytes_seek(bytes, index, SEEK_SET))
+			return 1;
+		if (get_byte(bytes) != 'W' || get_byte(bytes) != 'I' || read_bytes(bytes, &count, 4))
+			return 1;
+		if (frame >= count) {
+			fprintf(stderr, "frame %d not in sequence of %d frames\n", frame, count);
+			return 1;
 		}
-	}
-}
-
-int decode_plane(struct rle_reader *rle, int *val, int num, int plane)
-{
-	int int_bits = sizeof(int) * 8;
-	int sgn_pos = int_bits - 1;
-	int sig_pos = int_bits - 2;
-	int ref_pos = int_bits - 3;
-	int sig_mask = 1 << sig_pos;
-	int ref_mask = 1 << ref_pos;
-	for (int i = 0; i < num; ++i) {
-		if (!(val[i] & ref_mask)) {
-			int bit = get_rle(rle);
-			if (bit < 0)
-				return bit;
-			val[i] |= bit << plane;
-			if (bit) {
-				int sgn = rle_get_bit(rle);
-				if (sgn < 0)
-					return sgn;
-				val[i] |= (sgn << sgn_pos) | sig_mask;
+		long long offset = 0;
+		for (int i = 0; i <= frame; ++i) {
+			long long off;
+			int key = 0;
+			if (read_long_bytes(bytes, &off, 8) || read_bytes(bytes, &key, 1))
+				return 1;
+			if (key) {
+				first = i;
+				offset = off;
 			}
 		}
+		if (bytes_seek(bytes, offset, SEEK_SET))
+			return 1;
+		last = frame;
 	}
-	for (int i = 0; i < num; ++i) {
-		if (val[i] & ref_mask) {
-			int bit = rle_get_bit(rle);
-			if (bit < 0)
-				return bit;
-			val[i] |= bit << plane;
-		} else if (val[i] & sig_mask) {
-			val[i] ^= sig_mask | ref_mask;
-		}
-	}
-	return 0;
-}
-
-void process(int *buf, int num)
-{
-	int int_bits = sizeof(int) * 8;
-	int sgn_pos = int_bits - 1;
-	int sig_pos = int_bits - 2;
-	int ref_pos = int_bits - 3;
-	int sgn_mask = 1 << sgn_pos;
-	int sig_mask = 1 << sig_pos;
-	int ref_mask = 1 << ref_pos;
-	for (int i = 0; i < num; ++i) {
-		int val = buf[i] & ~(sig_mask | ref_mask);
-		if (val & sgn_mask)
-			val = -(val ^ sgn_mask);
-		buf[i] = val;
+	const char *fname = "/dev/stdout";
+	if (name[0] != '-' || name[1])
+		fname = name;
+	FILE *file = fopen(fname, "w");
+	if (!file) {
+		fprintf(stderr, "could not open \"%s\" file to write.\n", fname);
+		return 1;
 	}
-}
-
-int decode_root(struct vli_reader *vli, int *val, int num)
-{
-	int cnt = get_vli(vli);
-	if (cnt < 0)
-		return cnt;
-	for (int i = 0; cnt && i < num; ++i) {
-		int ret = vli_read_bits(vli, val + i, cnt);
-		if (ret)
-			return ret;
-		if (val[i] && (ret = vli_get_bit(vli)))
-			val[i] = -val[i];
-		if (ret < 0)
-			return ret;
+	int *reference = 0, ret = 1;
+	for (int i = first; last < 0 || i <= last; ++i) {
+		if (get_byte(bytes) != 'W')
+			goto end;
+		int number = get_byte(bytes);
+		if (number == 'I' && last < 0)
+			break;
+		struct picture *picture = decode(bytes, number, &reference, -1, -1, 0, 0);
+		if (!picture)
+			goto end;
+		int err = (last < 0 || i == last) && !write_pnm_file(file, fname, picture);
+		delete_picture(picture);
+		if (err)
+			goto end;
 	}
-	return 0;
+	ret = 0;
+end:
+	free(reference);
+	fclose(file);
+	return ret;
 }
 
 int main(int argc, char **argv)
 {
+	char *prog = argv[0];
+	int frame = -1, layers = -1;
+	char *state = 0;
+	int pyramid = 0;
+	for (; argc > 1 && argv[1][0] == '-' && argv[1][1]; --argc, ++argv) {
+		if (!strcmp(argv[1], "-f") && argc > 2 && (frame = atoi(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-r") && argc > 2 && (state = argv[2]))
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-l") && argc > 2 && (layers = atoi(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-p"))
+			pyramid = 1;
+		else
+			goto usage;
+	}
 	if (argc < 3 || argc > 4) {
-		fprintf(stderr, "usage: %s input.dwt output.pnm [PIXELS]\n", argv[0]);
+usage:
+		fprintf(stderr, "usage: %s [-r STATE] [-p] [-l LAYERS] input.dwt output.pnm [PIXELS]\n", prog);
+		fprintf(stderr, "       %s [-f FRAME] input.dwt output.pnm\n", prog);
 		return 1;
 	}
 	struct bytes_reader *bytes = bytes_reader(argv[1]);
@@ -146,124 +99,28 @@ int main(int argc, char **argv)
 	if (letter != 'W')
 		return 1;
 	int number = get_byte(bytes);
-	if (number != '5' && number != '6')
-		return 1;
-	int color = number == '6';
-	int width, height;
-	if (read_bytes(bytes, &width, 2) || read_bytes(bytes, &height, 2))
-		return 1;
-	++width;
-	++height;
-	int min_len = 8;
-	if (width < min_len || height < min_len)
-		return 1;
-	struct bits_reader *bits = bits_reader(bytes);
-	struct vli_reader *vli = vli_reader(bits);
-	int lengths[16], pixels[16], widths[16], heights[16];
-	int levels = compute_lengths(lengths, pixels, widths, heights, width, height, min_len);
-	int levels_max = levels;
-	if (argc >= 4) {
-		int pixels_max = atoi(argv[3]);
-		while (levels_max > 0 && pixels[levels_max] > pixels_max)
-			--levels_max;
-		width = widths[levels_max];
-		height = heights[levels_max];
+	if (number == 'S') {
+		if (argc != 3 || state || pyramid || layers >= 0)
+			goto usage;
+		int ret = decode_sequence(bytes, argv[2], frame);
+		close_bytes_reader(bytes);
+		return ret;
 	}
-	int total = width * height;
-	int channels = color ? 3 : 1;
-	int *buffers[3];
-	for (int chan = 0; chan < channels; ++chan)
-		buffers[chan] = malloc(sizeof(int) * total);
-	for (int chan = 0; chan < channels; ++chan)
-		for (int i = 0; i < total; ++i)
-			buffers[chan][i] = 0;
-	for (int chan = 0; chan < channels; ++chan)
-		if (decode_root(vli, buffers[chan], pixels[0]))
-			return 1;
-	int planes[channels];
-	for (int chan = 0; chan < channels; ++chan)
-		if ((planes[chan] = get_vli(vli)) < 0)
-			return 1;
-	int planes_max = 0;
-	for (int chan = 0; chan < channels; ++chan)
-		if (planes_max < planes[chan])
-			planes_max = planes[chan];
-	int maximum = levels > planes_max ? levels : planes_max;
-	int layers_max = 2 * maximum - 1;
-	int missing[channels * 16];
-	for (int chan = 0; chan < channels; ++chan)
-		for (int i = 0; i < levels; ++i)
-			missing[chan * 16 + i] = planes[chan];
-	int level = -1;
-	struct rle_reader *rle = rle_reader(vli);
-	if (!levels_max)
-		goto end;
-	if (planes_max == planes[0]) {
-		int num = pixels[1] - pixels[0];
-		level = 0;
-		if (decode_plane(rle, buffers[0] + pixels[0], num, planes[0] - 1))
-			goto end;
-		--missing[0];
-	}
-	for (int layers = 0; layers < layers_max; ++layers) {
-		for (int l = 0, off = pixels[0],
-			num = pixels[l + 1] - pixels[l];
-			l < levels && l <= layers + 1; off += num, ++l,
-			num = pixels[l + 1] - pixels[l]) {
-			if (l >= levels_max)
-				goto end;
-			for (int chan = 0; chan < 1; ++chan) {
-				int plane = planes_max - 1 - (layers + 1 - l);
-				if (plane < 0 || plane >= planes[chan])
-					continue;
-				if (level < l)
-					level = l;
-				if (decode_plane(rle, buffers[chan] + off, num, plane))
-					goto end;
-				--missing[chan * 16 + l];
-			}
-		}
-		for (int l = 0, off = pixels[0],
-			num = pixels[l + 1] - pixels[l];
-			l < levels && l <= layers; off += num, ++l,
-			num = pixels[l + 1] - pixels[l]) {
-			if (l >= levels_max)
-				goto end;
-			for (int chan = 1; chan < channels; ++chan) {
-				int plane = planes_max - 1 - (layers - l);
-				if (plane < 0 || plane >= planes[chan])
-					continue;
-				if (level < l)
-					level = l;
-				if (decode_plane(rle, buffers[chan] + off, num, plane))
-					goto end;
-				--missing[chan * 16 + l];
-			}
-		}
-	}
-end:
-	delete_rle_reader(rle);
-	delete_vli_reader(vli);
-	close_bits_reader(bits);
+	if (frame >= 0)
+		goto usage;
+	int pixels_max = -1;
+	if (argc >= 4)
+		pixels_max = atoi(argv[3]);
+	struct state resume = { 0 };
+	resume.name = state;
+	struct picture *picture = decode(bytes, number, 0, pixels_max, layers, state ? &resume : 0, pyramid ? argv[2] : 0);
 	close_bytes_reader(bytes);
-	for (int chan = 0; chan < channels; ++chan)
-		process(buffers[chan] + pixels[0], pixels[level + 1] - pixels[0]);
-	levels = level + 1;
-	width = widths[levels];
-	height = heights[levels];
-	total = pixels[levels];
-	struct image *image = new_image(width, height, channels);
-	int *temp = malloc(sizeof(int) * channels * total);
-	reconstruction(temp, buffers, missing, widths, heights, lengths, levels, channels);
-	transformation(image->buffer, temp, min_len, width, height, 1, 1, width * channels, channels);
-	for (int chan = 0; chan < channels; ++chan)
-		free(buffers[chan]);
-	free(temp);
-	if (color)
-		rgb_from_ycocg(image);
-	if (!write_pnm(argv[2], image))
+	if (!picture)
 		return 1;
-	delete_image(image);
+	if (!pyramid && !write_pnm(argv[2], picture))
+		return 1;
+	delete_picture(picture);
 	return 0;
 }
 
+
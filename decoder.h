@@ -0,0 +1,590 @@
+/*
+Decoding of wavelet coefficients from an embedded stream and their inverse transformation
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "layout.h"
+#include "wavelet.h"
+#include "utils.h"
+#include "tree.h"
+#include "image.h"
+#include "pnm.h"
+#include "state.h"
+#include "entropy.h"
+#include "rle.h"
+#include "vli.h"
+#include "bits.h"
+#include "bytes.h"
+#include "alloc.h"
+#include "legacy.h"
+
+#define OFFSET_NEW 2
+#define OFFSET_REF 4
+
+void inverse_transformation(int *val, int levels, int W, int H, int S, int SW, struct wavelet *wavelet)
+{
+	if (levels > 1)
+		inverse_transformation(val, levels - 1, (W + 1) / 2, (H + 1) / 2, 2 * S, SW, wavelet);
+	wavelet_columns(wavelet, val, H, S * SW, W, S);
+	for (int j = 0; j < H; ++j)
+		wavelet->row(val + S * SW * j, W, S, 1, 1);
+}
+
+struct synthesis_job {
+	int *val, levels, W, H, SW;
+	struct wavelet *wavelet;
+};
+
+void *synthesis_loop(void *data)
+{
+	struct synthesis_job *job = data;
+	if (job->levels > 1)
+		inverse_transformation(job->val, job->levels - 1, (job->W + 1) / 2, (job->H + 1) / 2, 2, job->SW, job->wavelet);
+	if (job->levels)
+		job->wavelet->col(job->val, job->H, job->SW, job->W, 1);
+	return 0;
+}
+
+void synthesis(uint8_t *output, int **planes, int levels, int W, int H, int SW, int CH, int transform, struct wavelet *wavelet)
+{
+	struct synthesis_job jobs[MAX_CHANNELS];
+	pthread_t threads[MAX_CHANNELS];
+	int started[MAX_CHANNELS];
+	for (int chan = CH - 1; chan >= 0; --chan) {
+		jobs[chan] = (struct synthesis_job){ planes[chan], levels, W, H, SW, wavelet };
+		started[chan] = BAND_THREADS && chan && !pthread_create(threads + chan, 0, synthesis_loop, jobs + chan);
+		if (!started[chan])
+			synthesis_loop(jobs + chan);
+	}
+	for (int chan = 1; chan < CH; ++chan)
+		if (started[chan])
+			pthread_join(threads[chan], 0);
+	for (int j = 0; j < H; ++j) {
+		int *rows[MAX_CHANNELS];
+		for (int chan = 0; chan < CH; ++chan) {
+			rows[chan] = planes[chan] + SW * j;
+			if (levels)
+				wavelet->row(rows[chan], W, 1, 1, 1);
+		}
+		narrow_row(output + (size_t)W * CH * j, rows, 1, W, CH, transform);
+	}
+}
+
+int dequantization_bias(int mag, int missing)
+{
+	int offset = mag >> missing == 1 ? OFFSET_NEW : OFFSET_REF;
+	return mag && missing > 0 ? (int)(((long long)offset << missing) >> 3) : 0;
+}
+
+void dequantization(int *val, int num, int missing)
+{
+	for (int i = 0; i < num; ++i) {
+		int bias = dequantization_bias(abs(val[i]), missing);
+		val[i] += val[i] < 0 ? -bias : bias;
+	}
+}
+
+void dequantization_cut(int *val, int num, int plane, int pos)
+{
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	int mix_mask = sgn_mask | sig_mask | ref_mask;
+	int refined = pos - num;
+	for (int i = 0; i < num; ++i) {
+		int known = val[i] & ref_mask ? i < refined : refined >= 0 || i < pos;
+		int mag = val[i] & ~mix_mask;
+		val[i] = (val[i] & mix_mask) | (mag + dequantization_bias(mag, plane + 1 - known));
+	}
+}
+
+int decode_plane(struct entropy_reader *ent, int *chn, int *par, unsigned char *tree, int off, int num, int plane, int kids, int ctx, int *pos)
+{
+	int *val = chn + off;
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	int mix_mask = sgn_mask | sig_mask | ref_mask;
+	if (tree && kids) {
+		*pos = 0;
+		kids = entropy_get_bit(ent, ctx + CONTEXT_TREE);
+		if (kids < 0)
+			return kids;
+	}
+	for (int i = 0; i < num; ++i) {
+		*pos = i;
+		if (tree) {
+			int cov = plane > 0 && par[off + i] >= 0 && tree[par[off + i]];
+			tree[off + i] = cov;
+			if (cov)
+				continue;
+		}
+		if (!(val[i] & ref_mask)) {
+			int sig = ctx + CONTEXT_SIG;
+			if (ent->arith) {
+				sig += i > 0 && (val[i - 1] & (sig_mask | ref_mask));
+				sig += i + 1 < num && (val[i + 1] & ref_mask);
+				if (par[off + i] >= 0 && (chn[par[off + i]] & ~mix_mask) >> plane)
+					sig += 3;
+			}
+			int bit = entropy_get_sig(ent, sig);
+			if (bit < 0)
+				return bit;
+			val[i] |= bit << plane;
+			if (bit) {
+				int sgn = entropy_get_bit(ent, ctx + CONTEXT_SGN);
+				if (sgn < 0)
+					return sgn;
+				val[i] |= (sgn << sgn_pos) | sig_mask;
+			} else if (tree && kids) {
+				int desc = entropy_get_sig(ent, ctx + CONTEXT_ZTR);
+				if (desc < 0)
+					return desc;
+				tree[off + i] = !desc;
+			}
+		}
+	}
+	for (int i = 0; i < num; ++i) {
+		*pos = num + i;
+		if (val[i] & ref_mask) {
+			int ref = ctx + CONTEXT_REF + ((val[i] & ~mix_mask) >> (plane + 1) == 1);
+			int bit = entropy_get_bit(ent, ref);
+			if (bit < 0)
+				return bit;
+			val[i] |= bit << plane;
+		} else if (val[i] & sig_mask) {
+			val[i] ^= sig_mask | ref_mask;
+		}
+	}
+	int ret = entropy_get_end(ent, ctx);
+	if (ret)
+		return ret;
+	*pos = 2 * num;
+	return 0;
+}
+
+void twos_complement(int *buf, int num)
+{
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	for (int i = 0; i < num; ++i) {
+		int val = buf[i] & ~(sig_mask | ref_mask);
+		if (val & sgn_mask)
+			val = -(val ^ sgn_mask);
+		buf[i] = val;
+	}
+}
+
+int decode_root(struct vli_reader *vli, int *val, int W, int H)
+{
+	for (int j = 0; j < H; ++j) {
+		for (int i = 0; i < W; ++i) {
+			int res = get_vli(vli);
+			if (res < 0)
+				return res;
+			res = res & 1 ? -(res + 1) / 2 : res / 2;
+			val[W * j + i] = res + median_predictor(val, i, j, W, 1);
+		}
+	}
+	return 0;
+}
+
+int write_level(FILE *file, const char *fname, int **planes, int W, int H, int S, int SW, int CH, int transform)
+{
+	struct picture *picture = new_picture(W, H, CH);
+	for (int j = 0; j < H; ++j) {
+		int *rows[MAX_CHANNELS];
+		for (int chan = 0; chan < CH; ++chan)
+			rows[chan] = planes[chan] + S * SW * j;
+		narrow_row(picture->buffer + (size_t)W * CH * j, rows, S, W, CH, transform);
+	}
+	int ret = write_pnm_file(file, fname, picture);
+	delete_picture(picture);
+	return ret;
+}
+
+int decode_coefficients(struct bytes_reader *bytes, int number, int **reference, int pixels_max, int layers_limit, struct state *state, int **buffers, int *header, int *reached)
+{
+	bytes->sum = BYTES_SUM;
+	if (number != 'V' || get_byte(bytes) != LAYOUT_VERSION || (number = get_byte(bytes)) < '5' || number > '9') {
+		fprintf(stderr, "unknown stream layout\n");
+		return -1;
+	}
+	int channels = number == '6' || number == '8' ? 3 : 1;
+	if (number == '9' && ((channels = get_byte(bytes)) < 1 || channels > MAX_CHANNELS))
+		return -1;
+	int large = number > '6';
+	int width, height;
+	if (read_bytes(bytes, &width, 2 + 2 * large) || read_bytes(bytes, &height, 2 + 2 * large))
+		return -1;
+	int mode = get_byte(bytes);
+	if (mode < 0 || mode > 127)
+		return -1;
+	int arith = mode & 1;
+	int zerotree = mode >> 1 & 1;
+	int temporal = mode >> 2 & 1;
+	int transform = mode >> 3 & 7;
+	int scan = mode >> 6;
+	if (!valid_transform(transform, channels))
+		return -1;
+	if (temporal && (!reference || !*reference)) {
+		fprintf(stderr, "missing reference frame\n");
+		return -1;
+	}
+	int wavelet = get_byte(bytes);
+	if (wavelet < 0 || wavelet >= WAVELETS)
+		return -1;
+	++width;
+	++height;
+	if (!valid_size(width, height))
+		return -1;
+	int levels = get_byte(bytes);
+	if (levels < 1 || levels > MAX_LEVELS)
+		return -1;
+	int end = get_byte(bytes);
+	if (end < 0)
+		return -1;
+	int head[7] = { number, channels, width, height, mode, wavelet, levels };
+	struct bits_reader *bits = bits_reader(bytes);
+	struct vli_reader *vli = vli_reader(bits);
+	int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+	compute_lengths(lengths, pixels, widths, heights, width, height, levels);
+	int levels_max = levels;
+	if (pixels_max >= 0) {
+		while (levels_max > 0 && pixels[levels_max] > pixels_max)
+			--levels_max;
+		width = widths[levels_max];
+		height = heights[levels_max];
+	}
+	int total = state ? pixels[levels] : width * height;
+	for (int chan = 0; chan < channels; ++chan)
+		buffers[chan] = alloc_frame(sizeof(int) * total);
+	for (int chan = 0; chan < channels; ++chan)
+		for (int i = 0; i < total; ++i)
+			buffers[chan][i] = 0;
+	unsigned char *trees[MAX_CHANNELS] = { 0 };
+	for (int chan = 0; zerotree && chan < channels; ++chan)
+		trees[chan] = calloc(total, 1);
+	int planes[channels * MAX_LEVELS];
+	memset(planes, 0, sizeof(planes));
+	int level = -1;
+	struct snapshot *snap = 0;
+	struct step *steps = 0;
+	int resume = 0, done = 0;
+	if (state) {
+		snap = malloc(sizeof(struct snapshot));
+		int found = 0;
+		FILE *file = state->memory ? 0 : fopen(state->name, "r");
+		if (file) {
+			if (load_state(file, state->name, head, planes, &level, snap, buffers, trees, channels, pixels)) {
+				fprintf(stderr, "could not load state \"%s\"\n", state->name);
+				fclose(file);
+				goto fail;
+			}
+			fclose(file);
+			found = 1;
+		} else if (state->memory && state->buffers[0]) {
+			if (restore_state(state, head, planes, &level, snap, buffers, trees, channels))
+				goto fail;
+			found = 1;
+		}
+		if (found) {
+			if ((levels_max < levels && snap->layer >= levels_max) || (layers_limit >= 0 && snap->layer > layers_limit)) {
+				for (int chan = 0; chan < channels; ++chan)
+					memset(buffers[chan], 0, sizeof(int) * total);
+				for (int chan = 0; trees[chan] && chan < channels; ++chan)
+					memset(trees[chan], 0, total);
+				memset(planes, 0, sizeof(planes));
+				level = -1;
+			} else {
+				if (bytes_skip(bytes, snap->pos - bytes_tell(bytes)))
+					goto fail;
+				if (bytes->sum != snap->sum) {
+					fprintf(stderr, "state \"%s\" does not belong to this stream\n", state->name);
+					goto fail;
+				}
+				bits->acc = snap->acc;
+				bits->cnt = snap->cnt;
+				resume = 1;
+			}
+		}
+	}
+	for (int chan = 0; !resume && chan < channels; ++chan)
+		if (decode_root(vli, buffers[chan], widths[0], heights[0]))
+			goto fail;
+	for (int chan = 0; !resume && chan < channels; ++chan) {
+		int chan_max = get_vli(vli);
+		if (chan_max < 0 || chan_max > (int)sizeof(int) * 8 - 3)
+			goto fail;
+		for (int l = 0; l < levels; ++l) {
+			int diff = get_vli(vli);
+			if (diff < 0 || diff > chan_max)
+				goto fail;
+			planes[chan * MAX_LEVELS + l] = chan_max - diff;
+		}
+	}
+	int planes_max = 0;
+	for (int chan = 0; chan < channels; ++chan)
+		for (int l = 0; l < levels; ++l)
+			if (planes_max < planes[chan * MAX_LEVELS + l])
+				planes_max = planes[chan * MAX_LEVELS + l];
+	int maximum = levels > planes_max ? levels : planes_max;
+	int layers_max = 2 * maximum - 1;
+	if (end >= layers_max)
+		goto fail;
+	if (!end)
+		end = layers_max;
+	int missing[MAX_CHANNELS * MAX_LEVELS];
+	for (int chan = 0; chan < channels; ++chan)
+		for (int i = 0; i < levels; ++i)
+			missing[chan * MAX_LEVELS + i] = resume ? snap->missing[chan * MAX_LEVELS + i] : planes[chan * MAX_LEVELS + i];
+	int *parents = 0;
+	if (arith || zerotree) {
+		parents = alloc_frame(sizeof(int) * pixels[levels]);
+		compute_parents(parents, widths, heights, lengths, levels, scan);
+	}
+	struct arith_reader *ac = 0;
+	if (arith && resume) {
+		ac = malloc(sizeof(struct arith_reader));
+		*ac = (struct arith_reader){ bytes, snap->range, snap->code, 0 };
+	} else if (arith) {
+		bits_align(bits);
+		ac = arith_reader(bytes);
+	}
+	struct entropy_reader *ent = entropy_reader(bits, ac);
+	if (resume) {
+		for (int i = 0; i < RLE_CONTEXTS; ++i)
+			ent->rle[i]->vli->order = snap->orders[i];
+		memcpy(ent->probs, snap->probs, sizeof(ent->probs));
+	} else if (snap && take_snapshot(snap, -1, ent, bits, missing)) {
+		free(snap);
+		snap = 0;
+	}
+	if (snap)
+		steps = malloc(sizeof(struct step) * (channels * levels * (layers_max + 1) + 1));
+	int count = 0, pos = 0;
+	struct step cut = { -1, 0, 0, 0 };
+	if (!levels_max)
+		goto end;
+	if (planes_max == planes[0] && (!resume || snap->layer < 0)) {
+		int num = pixels[1] - pixels[0];
+		level = 0;
+		cut = (struct step){ 0, pixels[0], num, planes_max - 1 };
+		if (steps)
+			steps[count++] = cut;
+		if (decode_plane(ent, buffers[0], parents, trees[0], pixels[0], num, planes_max - 1, 0, entropy_context(0, 0), &pos))
+			goto end;
+		--missing[0];
+	}
+	for (int layers = resume && snap->layer > 0 ? snap->layer : 0; layers < layers_max; ++layers) {
+		if (snap && !take_snapshot(snap, layers, ent, bits, missing))
+			count = 0;
+		if (layers == layers_limit || layers == end || (state && state->stop && snap->pos >= state->stop))
+			goto end;
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers + 1; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			if (l >= levels_max)
+				goto end;
+			for (int chan = 0; chan < 1; ++chan) {
+				int plane = planes_max - 1 - (layers + 1 - l);
+				int *plns = planes + chan * MAX_LEVELS;
+				if (plane < 0)
+					continue;
+				if (level < l)
+					level = l;
+				if (plane >= plns[l])
+					continue;
+				cut = (struct step){ chan, off, num, plane };
+				if (steps)
+					steps[count++] = cut;
+				int kids = l + 1 < levels && plane + 1 < plns[l + 1];
+				if (decode_plane(ent, buffers[chan], parents, trees[chan], off, num, plane, kids, entropy_context(chan, l), &pos))
+					goto end;
+				--missing[chan * MAX_LEVELS + l];
+			}
+		}
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			if (l >= levels_max)
+				goto end;
+			for (int chan = 1; chan < channels; ++chan) {
+				int plane = planes_max - 1 - (layers - l);
+				int *plns = planes + chan * MAX_LEVELS;
+				if (plane < 0)
+					continue;
+				if (level < l)
+					level = l;
+				if (plane >= plns[l])
+					continue;
+				cut = (struct step){ chan, off, num, plane };
+				if (steps)
+					steps[count++] = cut;
+				int kids = l + 1 < levels && plane + 1 < plns[l + 1];
+				if (decode_plane(ent, buffers[chan], parents, trees[chan], off, num, plane, kids, entropy_context(chan, l), &pos))
+					goto end;
+				--missing[chan * MAX_LEVELS + l];
+			}
+		}
+	}
+	if (snap && !take_snapshot(snap, layers_max, ent, bits, missing))
+		count = 0;
+	done = 1;
+end:
+	if (done || level > levels_max - 1)
+		level = levels_max - 1;
+	if (snap) {
+		int **kept = malloc(sizeof(int *) * (count + 1));
+		for (int i = 0; i < count; ++i) {
+			kept[i] = malloc(sizeof(int) * steps[i].num);
+			memcpy(kept[i], buffers[steps[i].chan] + steps[i].off, sizeof(int) * steps[i].num);
+			undo_plane(buffers[steps[i].chan] + steps[i].off, steps[i].num, steps[i].plane);
+		}
+		if (state->memory)
+			keep_state(state, head, planes, level, snap, buffers, trees, channels, pixels[level + 1]);
+		else
+			save_state(state->name, head, planes, level, snap, buffers, trees, channels, pixels[level + 1]);
+		for (int i = count - 1; i >= 0; --i) {
+			if (!state->raw)
+				memcpy(buffers[steps[i].chan] + steps[i].off, kept[i], sizeof(int) * steps[i].num);
+			free(kept[i]);
+		}
+		free(kept);
+		free(steps);
+		free(snap);
+	}
+	delete_entropy_reader(ent);
+	if (ac)
+		delete_arith_reader(ac);
+	free(parents);
+	for (int chan = 0; chan < channels; ++chan)
+		free(trees[chan]);
+	delete_vli_reader(vli);
+	close_bits_reader(bits);
+	int raw = state && state->raw;
+	if (cut.chan >= 0 && pos < 2 * cut.num && !raw)
+		dequantization_cut(buffers[cut.chan] + cut.off, cut.num, cut.plane, pos);
+	else
+		cut.chan = -1;
+	for (int chan = 0; chan < channels; ++chan)
+		twos_complement(buffers[chan] + pixels[0], pixels[level + 1] - pixels[0]);
+	for (int chan = 0; chan < channels; ++chan)
+		for (int l = 0; l <= level; ++l)
+			if (!raw && (chan != cut.chan || pixels[l] != cut.off))
+				dequantization(buffers[chan] + pixels[l], pixels[l + 1] - pixels[l], missing[chan * MAX_LEVELS + l]);
+	if (reference) {
+		if (level != levels - 1) {
+			fprintf(stderr, "can not use incomplete frame as reference\n");
+			for (int chan = 0; chan < channels; ++chan)
+				free(buffers[chan]);
+			return -1;
+		}
+		if (!temporal) {
+			free(*reference);
+			*reference = alloc_frame(sizeof(int) * channels * total);
+		}
+		for (int chan = 0; chan < channels; ++chan) {
+			for (int i = 0; i < total; ++i) {
+				if (temporal)
+					buffers[chan][i] += (*reference)[(size_t)total * chan + i];
+				(*reference)[(size_t)total * chan + i] = buffers[chan][i];
+			}
+		}
+	}
+	memcpy(header, head, sizeof(head));
+	*reached = level;
+	return 0;
+fail:
+	free(snap);
+	for (int chan = 0; chan < channels; ++chan) {
+		free(trees[chan]);
+		free(buffers[chan]);
+	}
+	delete_vli_reader(vli);
+	close_bits_reader(bits);
+	return -1;
+}
+
+struct picture *decode(struct bytes_reader *bytes, int number, int **reference, int pixels_max, int layers_limit, struct state *state, char *pyramid)
+{
+	int *buffers[MAX_CHANNELS], head[7], level;
+	if (number == '5' || number == '6') {
+		if (reference || pyramid || (state && !state->memory)) {
+			fprintf(stderr, "streams of the first layout can only be decoded as a whole\n");
+			return 0;
+		}
+		return legacy_decode(bytes, number, pixels_max, layers_limit);
+	}
+	if (decode_coefficients(bytes, number, reference, pixels_max, layers_limit, state, buffers, head, &level))
+		return 0;
+	int channels = head[1], transform = head[4] >> 3 & 7, scan = head[4] >> 6, wavelet = head[5];
+	int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+	compute_lengths(lengths, pixels, widths, heights, head[2], head[3], head[6]);
+	int levels = level + 1;
+	int width = widths[levels];
+	int height = heights[levels];
+	int total = pixels[levels];
+	int *order = alloc_frame(sizeof(int) * total);
+	compute_order(order, widths, heights, lengths, levels, levels, scan);
+	int *temp = alloc_frame(sizeof(int) * total);
+	for (int chan = 0; chan < channels; ++chan) {
+		scatter(temp, buffers[chan], order, total);
+		int *swap = buffers[chan];
+		buffers[chan] = temp;
+		temp = swap;
+	}
+	free(temp);
+	free(order);
+	struct picture *picture = 0;
+	const char *fname = "/dev/stdout";
+	FILE *file = 0;
+	if (pyramid) {
+		if (pyramid[0] != '-' || pyramid[1])
+			fname = pyramid;
+		if (!(file = fopen(fname, "w"))) {
+			fprintf(stderr, "could not open \"%s\" file to write.\n", fname);
+			goto end;
+		}
+		for (int l = 0; l < levels; ++l) {
+			int S = 1 << (levels - l);
+			for (int chan = 0; l && chan < channels; ++chan)
+				inverse_transformation(buffers[chan], 1, widths[l], heights[l], S, width, inverse_wavelets + wavelet);
+			if (!write_level(file, fname, buffers, widths[l], heights[l], S, width, channels, transform))
+				goto end;
+		}
+	}
+	picture = new_picture(width, height, channels);
+	synthesis(picture->buffer, buffers, pyramid && levels ? 1 : levels, width, height, width, channels, transform, inverse_wavelets + wavelet);
+	if (file && !write_pnm_file(file, fname, picture)) {
+		delete_picture(picture);
+		picture = 0;
+	}
+end:
+	for (int chan = 0; chan < channels; ++chan)
+		free(buffers[chan]);
+	if (file)
+		fclose(file);
+	return picture;
+}
@@ -0,0 +1,342 @@
+/*
+Daemon serving decoded pictures from a cache of decoder states
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#define _XOPEN_SOURCE 700
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "decoder.h"
+
+#define DWTD_CACHE 256
+
+struct entry {
+	struct entry *prev, *next;
+	char *path;
+	long long size, mtime;
+	int pixels, layers;
+	struct picture *picture;
+	struct state state;
+	size_t bytes;
+};
+
+struct cache {
+	struct entry list;
+	size_t bytes, limit;
+	pthread_mutex_t mutex;
+};
+
+struct entry *new_entry(char *path, long long size, long long mtime, int pixels, int layers)
+{
+	struct entry *entry = calloc(1, sizeof(struct entry));
+	entry->path = strdup(path);
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->pixels = pixels;
+	entry->layers = layers;
+	entry->bytes = sizeof(struct entry) + strlen(path) + 1;
+	return entry;
+}
+
+void delete_entry(struct entry *entry)
+{
+	if (entry->picture)
+		delete_picture(entry->picture);
+	clear_state(&entry->state);
+	free(entry->path);
+	free(entry);
+}
+
+void unlink_entry(struct cache *cache, struct entry *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	cache->bytes -= entry->bytes;
+}
+
+void insert_entry(struct cache *cache, struct entry *entry)
+{
+	entry->prev = &cache->list;
+	entry->next = cache->list.next;
+	entry->next->prev = entry;
+	cache->list.next = entry;
+	cache->bytes += entry->bytes;
+}
+
+void evict_entries(struct cache *cache)
+{
+	while (cache->bytes > cache->limit && cache->list.prev != cache->list.next) {
+		struct entry *entry = cache->list.prev;
+		unlink_entry(cache, entry);
+		delete_entry(entry);
+	}
+}
+
+void replace_state(struct cache *cache, struct entry *entry, struct state *state)
+{
+	unlink_entry(cache, entry);
+	clear_state(&entry->state);
+	entry->state = *state;
+	entry->state.name = entry->path;
+	entry->bytes = sizeof(struct entry) + strlen(entry->path) + 1 + state->size;
+	insert_entry(cache, entry);
+}
+
+void take_state(struct cache *cache, struct entry *entry, struct state *state)
+{
+	unlink_entry(cache, entry);
+	*state = entry->state;
+	memset(&entry->state, 0, sizeof(struct state));
+	entry->bytes = sizeof(struct entry) + strlen(entry->path) + 1;
+	insert_entry(cache, entry);
+}
+
+void store_state(struct cache *cache, char *path, long long size, long long mtime, struct state *state)
+{
+	if (!state->buffers[0])
+		return;
+	struct entry *resume = 0;
+	for (struct entry *entry = cache->list.next; entry != &cache->list; entry = entry->next)
+		if (!entry->picture && entry->size == size && entry->mtime == mtime && !strcmp(entry->path, path))
+			resume = entry;
+	if (!resume) {
+		resume = new_entry(path, size, mtime, -1, -1);
+		insert_entry(cache, resume);
+	}
+	if (!resume->state.buffers[0] || state->layer > resume->state.layer)
+		replace_state(cache, resume, state);
+	else
+		clear_state(state);
+}
+
+void store_picture(struct cache *cache, struct entry *found)
+{
+	for (struct entry *entry = cache->list.next, *next; entry != &cache->list; entry = next) {
+		next = entry->next;
+		if (entry->picture && entry->pixels == found->pixels && entry->layers == found->layers && entry->size == found->size && entry->mtime == found->mtime && !strcmp(entry->path, found->path)) {
+			unlink_entry(cache, entry);
+			delete_entry(entry);
+		}
+	}
+	insert_entry(cache, found);
+}
+
+struct picture *copy_picture(struct picture *picture)
+{
+	struct picture *copy = new_picture(picture->width, picture->height, picture->channels);
+	memcpy(copy->buffer, picture->buffer, (size_t)picture->channels * picture->total);
+	return copy;
+}
+
+int serve(struct cache *cache, FILE *input, FILE *output)
+{
+	char line[4096];
+	int pixels, layers, offset;
+	if (!fgets(line, sizeof(line), input) || sscanf(line, "%d %d %n", &pixels, &layers, &offset) != 2)
+		return -1;
+	char *path = line + offset;
+	path[strcspn(path, "\n")] = 0;
+	struct stat info;
+	if (stat(path, &info)) {
+		fprintf(stderr, "could not access \"%s\"\n", path);
+		return -1;
+	}
+	long long size = info.st_size, mtime = info.st_mtime;
+	struct picture *picture = 0;
+	struct state state = { 0 };
+	pthread_mutex_lock(&cache->mutex);
+	for (struct entry *entry = cache->list.next, *next; entry != &cache->list; entry = next) {
+		next = entry->next;
+		if (strcmp(entry->path, path))
+			continue;
+		if (entry->size != size || entry->mtime != mtime) {
+			unlink_entry(cache, entry);
+			delete_entry(entry);
+		} else if (!entry->picture) {
+			take_state(cache, entry, &state);
+		} else if (!picture && entry->pixels == pixels && entry->layers == layers) {
+			unlink_entry(cache, entry);
+			insert_entry(cache, entry);
+			picture = copy_picture(entry->picture);
+		}
+	}
+	if (picture) {
+		store_state(cache, path, size, mtime, &state);
+		pthread_mutex_unlock(&cache->mutex);
+		int ret = write_pnm_file(output, path, picture) ? 0 : -1;
+		delete_picture(picture);
+		return ret;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	struct state old = state;
+	state.name = path;
+	state.memory = 1;
+	struct bytes_reader *bytes = bytes_reader(path);
+	if (bytes) {
+		int number = get_byte(bytes) == 'W' ? get_byte(bytes) : -1;
+		if (number != 'S')
+			picture = decode(bytes, number, 0, pixels, layers, &state, 0);
+		close_bytes_reader(bytes);
+	}
+	if (state.buffers[0] != old.buffers[0] && old.buffers[0]) {
+		if (state.layer > old.layer) {
+			clear_state(&old);
+		} else {
+			clear_state(&state);
+			state = old;
+		}
+	}
+	if (!picture)
+		fprintf(stderr, "could not decode \"%s\"\n", path);
+	int ret = picture && write_pnm_file(output, path, picture) ? 0 : -1;
+	pthread_mutex_lock(&cache->mutex);
+	store_state(cache, path, size, mtime, &state);
+	if (picture) {
+		struct entry *found = new_entry(path, size, mtime, pixels, layers);
+		found->picture = picture;
+		found->bytes += (size_t)picture->channels * picture->total;
+		store_picture(cache, found);
+	}
+	evict_entries(cache);
+	pthread_mutex_unlock(&cache->mutex);
+	return ret;
+}
+
+struct connection {
+	struct cache *cache;
+	int fd;
+};
+
+void *serve_loop(void *data)
+{
+	struct connection *conn = data;
+	FILE *input = fdopen(conn->fd, "r");
+	FILE *output = fdopen(dup(conn->fd), "w");
+	if (input && output)
+		serve(conn->cache, input, output);
+	if (input)
+		fclose(input);
+	else
+		close(conn->fd);
+	if (output)
+		fclose(output);
+	free(conn);
+	return 0;
+}
+
+int open_socket(char *name, struct sockaddr_un *addr)
+{
+	if (strlen(name) >= sizeof(addr->sun_path)) {
+		fprintf(stderr, "socket name \"%s\" is too long\n", name);
+		return -1;
+	}
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, name);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		fprintf(stderr, "could not create socket \"%s\"\n", name);
+	return fd;
+}
+
+int serve_socket(char *name, long long limit)
+{
+	struct sockaddr_un addr;
+	int fd = open_socket(name, &addr);
+	if (fd < 0)
+		return 1;
+	unlink(name);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16)) {
+		fprintf(stderr, "could not listen on socket \"%s\"\n", name);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	struct cache cache = { { 0 }, 0, limit, PTHREAD_MUTEX_INITIALIZER };
+	cache.list.prev = cache.list.next = &cache.list;
+	while (1) {
+		int conn = accept(fd, 0, 0);
+		if (conn < 0)
+			continue;
+		struct connection *job = malloc(sizeof(struct connection));
+		*job = (struct connection){ &cache, conn };
+		pthread_t thread;
+		if (pthread_create(&thread, 0, serve_loop, job))
+			serve_loop(job);
+		else
+			pthread_detach(thread);
+	}
+	return 0;
+}
+
+int request(char *name, char *input, char *output, int pixels, int layers)
+{
+	char *path = realpath(input, 0);
+	if (!path) {
+		fprintf(stderr, "could not find \"%s\"\n", input);
+		return 1;
+	}
+	struct sockaddr_un addr;
+	int fd = open_socket(name, &addr);
+	if (fd < 0)
+		return 1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "could not connect to socket \"%s\"\n", name);
+		return 1;
+	}
+	FILE *stream = fdopen(fd, "r+");
+	fprintf(stream, "%d %d %s\n", pixels, layers, path);
+	fflush(stream);
+	free(path);
+	const char *fname = "/dev/stdout";
+	if (output[0] != '-' || output[1])
+		fname = output;
+	FILE *file = 0;
+	char buffer[4096];
+	for (size_t num; (num = fread(buffer, 1, sizeof(buffer), stream));) {
+		if (!file && !(file = fopen(fname, "w"))) {
+			fprintf(stderr, "could not open \"%s\" file to write.\n", fname);
+			return 1;
+		}
+		if (num != fwrite(buffer, 1, num, file)) {
+			fprintf(stderr, "could not write to file \"%s\"\n", fname);
+			return 1;
+		}
+	}
+	fclose(stream);
+	if (!file) {
+		fprintf(stderr, "could not decode \"%s\"\n", input);
+		return 1;
+	}
+	fclose(file);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char *prog = argv[0];
+	int client = 0, layers = -1;
+	long long megabytes = DWTD_CACHE;
+	for (; argc > 1 && argv[1][0] == '-' && argv[1][1]; --argc, ++argv) {
+		if (!strcmp(argv[1], "-c"))
+			client = 1;
+		else if (!strcmp(argv[1], "-l") && argc > 2 && (layers = atoi(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-m") && argc > 2 && (megabytes = atoll(argv[2])) > 0)
+			--argc, ++argv;
+		else
+			goto usage;
+	}
+	if (client ? argc < 4 || argc > 5 : argc != 2 || layers >= 0) {
+usage:
+		fprintf(stderr, "usage: %s [-m MEGABYTES] socket\n", prog);
+		fprintf(stderr, "       %s -c [-l LAYERS] socket input.dwt output.pnm [PIXELS]\n", prog);
+		return 1;
+	}
+	if (client)
+		return request(argv[1], argv[2], argv[3], argc == 5 ? atoi(argv[4]) : -1, layers);
+	return serve_socket(argv[1], megabytes << 20);
+}
@@ -4,230 +4,239 @@ Encoder for lossless image compression based on the discrete wavelet transformat
 Copyright 2021 Ahmet Inan <xdsopl@gmail.com>
 */
 
-#include "hilbert.h"
-#include "cdf53.h"
+#define _DEFAULT_SOURCE
+#include "encoder.h"
 #include "utils.h"
 #include "pnm.h"
-#include "rle.h"
-#include "vli.h"
-#include "bits.h"
+#include "stripes.h"
 #include "bytes.h"
+#include "alloc.h"
 
-void transformation(int *out, int *in, int N0, int W, int H, int SO, int SI, int SW, int CH)
+int prepare(int **buffers, struct picture *picture, int transform, int wavelet, int levels, int min_len)
 {
-	for (int j = 0; j < H; ++j) {
-		cdf53(out + SO * SW * j, in + SI * SW * j, W, SO * CH, SI * CH, CH);
-		for (int i = 0; i < W * CH; ++i)
-			in[(SW * j + i) * SI] = out[(SW * j + i) * SO];
-	}
-	cdf53(out, in, H, SO * SW, SI * SW, W * CH);
-	int W2 = (W + 1) / 2, H2 = (H + 1) / 2;
-	for (int j = 0; j < H2; ++j)
-		for (int i = 0; i < W2 * CH; ++i)
-			in[(SW * j + i) * SI] = out[(SW * j + i) * SO];
-	if (W2 >= N0 && H2 >= N0)
-		transformation(out, in, N0, W2, H2, SO, SI, SW, CH);
+	int width = picture->width, height = picture->height, channels = picture->channels;
+	for (int chan = 0; chan < channels; ++chan)
+		buffers[chan] = alloc_frame(sizeof(int) * picture->total);
+	planar_from_picture(buffers, picture, transform, 0, height);
+	int levels_max = compute_levels(width, height, min_len);
+	if (levels)
+		return levels < levels_max ? levels : levels_max;
+	if (levels_max < 3)
+		return levels_max;
+	int *small = calloc((size_t)((width + 3) / 4) * ((height + 3) / 4) * channels, sizeof(int));
+	downsample(small, buffers, width, height, channels, 0, height);
+	levels = choose_levels(small, width, height, channels, levels_max, wavelets + wavelet);
+	free(small);
+	return levels;
 }
 
-void linearization(int *output, int *input, int *widths, int *heights, int *lengths, int levels, int channels)
+int prepare_stripes(int **buffers, struct picture *picture, struct stripe_reader *stripes, int *transform, int wavelet, int levels, int min_len)
 {
-	int width = widths[levels];
-	int height = heights[levels];
-	int total = width * height;
-	for (int y = 0; y < heights[0]; ++y) {
-		for (int x = 0; x < widths[0]; ++x) {
-			for (int chan = 0; chan < channels; ++chan) {
-				int v = input[channels * (width * y + x) + chan];
-				output[chan * total] = v;
-			}
-			++output;
-		}
+	int width = picture->width, height = picture->height, channels = picture->channels;
+	int first = height < STRIPE_ROWS ? height : STRIPE_ROWS;
+	if (wait_stripe(stripes, first))
+		return -1;
+	if (*transform < 0) {
+		struct picture stripe = { picture->buffer, width, first, width * first, channels };
+		*transform = choose_transform(&stripe);
 	}
-	for (int l = 0; l < levels; ++l) {
-		for (int i = 0; i < lengths[l + 1] * lengths[l + 1]; ++i) {
-			struct position pos = hilbert(lengths[l + 1], i);
-			if ((pos.x >= widths[l] || pos.y >= heights[l]) && pos.x < widths[l + 1] && pos.y < heights[l + 1]) {
-				for (int chan = 0; chan < channels; ++chan) {
-					int v = input[channels * (width * pos.y + pos.x) + chan];
-					output[chan * total] = v;
-				}
-				++output;
-			}
-		}
+	for (int chan = 0; chan < channels; ++chan)
+		buffers[chan] = alloc_frame(sizeof(int) * picture->total);
+	int levels_max = compute_levels(width, height, min_len);
+	int *small = 0;
+	if (!levels && levels_max >= 3)
+		small = calloc((size_t)((width + 3) / 4) * ((height + 3) / 4) * channels, sizeof(int));
+	for (int y = 0; y < height; y += STRIPE_ROWS) {
+		int last = height - y < STRIPE_ROWS ? height : y + STRIPE_ROWS;
+		if (wait_stripe(stripes, last))
+			return -1;
+		planar_from_picture(buffers, picture, *transform, y, last);
+		if (small)
+			downsample(small, buffers, width, height, channels, y, last);
+		for (int chan = 0; chan < channels; ++chan)
+			for (int j = y; j < last; ++j)
+				wavelets[wavelet].row(buffers[chan] + width * j, width, 1, 1, 1);
 	}
+	if (levels)
+		return levels < levels_max ? levels : levels_max;
+	if (!small)
+		return levels_max;
+	levels = choose_levels(small, width, height, channels, levels_max, wavelets + wavelet);
+	free(small);
+	return levels;
 }
 
-int encode_plane(struct rle_writer *rle, int *val, int num, int plane)
+int encode_sequence(char *input, char *output, int keyint, int mode, int transform, int wavelet, int levels, int min_len)
 {
-	int bit_mask = 1 << plane;
-	int int_bits = sizeof(int) * 8;
-	int sgn_pos = int_bits - 1;
-	int sig_pos = int_bits - 2;
-	int ref_pos = int_bits - 3;
-	int sgn_mask = 1 << sgn_pos;
-	int sig_mask = 1 << sig_pos;
-	int ref_mask = 1 << ref_pos;
-	for (int i = 0; i < num; ++i) {
-		if (!(val[i] & ref_mask)) {
-			int bit = val[i] & bit_mask;
-			int ret = put_rle(rle, bit);
-			if (ret)
-				return ret;
-			if (bit) {
-				int ret = rle_put_bit(rle, val[i] & sgn_mask);
-				if (ret)
-					return ret;
-				val[i] |= sig_mask;
-			}
-		}
+	const char *fname = "/dev/stdin";
+	if (input[0] != '-' || input[1])
+		fname = input;
+	FILE *file = fopen(fname, "r");
+	if (!file) {
+		fprintf(stderr, "could not open \"%s\" file to read\n", fname);
+		return 1;
 	}
-	for (int i = 0; i < num; ++i) {
-		if (val[i] & ref_mask) {
-			int bit = val[i] & bit_mask;
-			int ret = rle_put_bit(rle, bit);
-			if (ret)
-				return ret;
-		} else if (val[i] & sig_mask) {
-			val[i] ^= sig_mask | ref_mask;
-		}
+	struct bytes_writer *bytes = bytes_writer(output, 0);
+	if (!bytes) {
+		fclose(file);
+		return 1;
 	}
-	return 0;
-}
-
-void encode_root(struct vli_writer *vli, int *val, int num)
-{
-	int max = 0;
-	for (int i = 0; i < num; ++i)
-		if (max < abs(val[i]))
-			max = abs(val[i]);
-	int cnt = 1 + ilog2(max);
-	put_vli(vli, cnt);
-	for (int i = 0; cnt && i < num; ++i) {
-		vli_write_bits(vli, abs(val[i]), cnt);
-		if (val[i])
-			vli_put_bit(vli, val[i] < 0);
+	put_byte(bytes, 'W');
+	put_byte(bytes, 'S');
+	int count = 0, cap = 0, width = 0, height = 0, channels = 0, frame_levels = 0, frame_transform = 0, ret = 1;
+	long long *offsets = 0;
+	int *reference = 0;
+	unsigned char *keys = 0;
+	for (int c; (c = fgetc(file)) != EOF; ++count) {
+		ungetc(c, file);
+		struct picture *picture = read_pnm_file(file, fname);
+		if (!picture || !valid_size(picture->width, picture->height)) {
+			if (picture)
+				delete_picture(picture);
+			goto end;
+		}
+		int key = count % keyint == 0 || picture->width != width || picture->height != height || picture->channels != channels;
+		if (key) {
+			width = picture->width;
+			height = picture->height;
+			channels = picture->channels;
+			free(reference);
+			reference = alloc_frame(sizeof(int) * channels * width * height);
+			frame_transform = transform < 0 ? choose_transform(picture) : valid_transform(transform, channels) ? transform : 0;
+		}
+		int *buffers[MAX_CHANNELS];
+		frame_levels = prepare(buffers, picture, frame_transform, wavelet, key ? levels : frame_levels, min_len);
+		delete_picture(picture);
+		if (count >= cap) {
+			cap = 2 * cap + 16;
+			offsets = realloc(offsets, sizeof(long long) * cap);
+			keys = realloc(keys, cap);
+		}
+		offsets[count] = bytes_count(bytes);
+		keys[count] = key;
+		analysis(buffers, width, height, channels, mode >> 6 & 1, wavelet, frame_levels, 0, 0);
+		int err = encode(bytes, 0, buffers, width, height, channels, reference, mode | !key << 2 | frame_transform << 3, wavelet, frame_levels, 0, 0, 0);
+		for (int chan = 0; chan < channels; ++chan)
+			free(buffers[chan]);
+		if (err)
+			goto end;
 	}
-}
-
-int process(int *val, int num)
-{
-	int max = 0;
-	int int_bits = sizeof(int) * 8;
-	int sgn_pos = int_bits - 1;
-	int sig_pos = int_bits - 2;
-	int ref_pos = int_bits - 3;
-	int sgn_mask = 1 << sgn_pos;
-	int sig_mask = 1 << sig_pos;
-	int ref_mask = 1 << ref_pos;
-	int mix_mask = sgn_mask | sig_mask | ref_mask;
-	for (int i = 0; i < num; ++i) {
-		int sgn = val[i] < 0;
-		int mag = abs(val[i]);
-		if (max < mag)
-			max = mag;
-		val[i] = (sgn << sgn_pos) | (mag & ~mix_mask);
+	long long index = bytes_count(bytes);
+	put_byte(bytes, 'W');
+	put_byte(bytes, 'I');
+	write_bytes(bytes, count, 4);
+	for (int i = 0; i < count; ++i) {
+		write_bytes(bytes, offsets[i], 8);
+		put_byte(bytes, keys[i]);
 	}
-	return 1 + ilog2(max);
+	if (write_bytes(bytes, index, 8))
+		goto end;
+	fprintf(stderr, "%d frames (%lld KiB) encoded\n", count, (bytes_count(bytes) + 512) / 1024);
+	ret = 0;
+end:
+	fclose(file);
+	free(offsets);
+	free(keys);
+	free(reference);
+	close_bytes_writer(bytes);
+	return ret;
 }
 
 int main(int argc, char **argv)
 {
-	if (argc != 3 && argc != 4) {
-		fprintf(stderr, "usage: %s input.pnm output.dwt [CAPACITY]\n", argv[0]);
-		return 1;
+	char *prog = argv[0];
+	int arith = 0, zerotree = 0, transform = -1, scan = 0, wavelet = 0, levels = 0, min_len = 8, keyint = 0, budget = 0, pipelined = 0;
+	char *index_name = 0;
+	for (; argc > 1 && argv[1][0] == '-' && argv[1][1]; --argc, ++argv) {
+		if (!strcmp(argv[1], "-a"))
+			arith = 1;
+		else if (!strcmp(argv[1], "-z"))
+			zerotree = 1;
+		else if (!strcmp(argv[1], "-p"))
+			pipelined = 1;
+		else if (!strcmp(argv[1], "-c") && argc > 2 && (transform = transform_index(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-o") && argc > 2 && (scan = scan_index(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-w") && argc > 2 && (wavelet = wavelet_index(argv[2])) >= 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-l") && argc > 2 && (levels = atoi(argv[2])) >= 0 && levels <= MAX_LEVELS)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-m") && argc > 2 && (min_len = atoi(argv[2])) > 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-s") && argc > 2 && (keyint = atoi(argv[2])) > 0)
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-i") && argc > 2 && (index_name = argv[2]))
+			--argc, ++argv;
+		else if (!strcmp(argv[1], "-b") && argc > 2 && (budget = atoi(argv[2])) > 0)
+			--argc, ++argv;
+		else
+			goto usage;
 	}
-	struct image *image = read_pnm(argv[1]);
-	if (!image || image->width > 65536 || image->height > 65536)
+	if ((argc != 3 && argc != 4) || (keyint && (argc != 3 || index_name || budget || pipelined))) {
+usage:
+		fprintf(stderr, "usage: %s [-a] [-z] [-p] [-c ycocg|none|rct|green|delta] [-o hilbert|morton] [-w 53|haar|26|137] [-l LEVELS] [-m MINLEN] [-i INDEX] [-b LAYERS] input.pnm output.dwt [CAPACITY]\n", prog);
+		fprintf(stderr, "       %s [-a] [-z] [-c ycocg|none|rct|green|delta] [-o hilbert|morton] [-w 53|haar|26|137] [-l LEVELS] [-m MINLEN] -s KEYINT input.pnm output.dwt\n", prog);
 		return 1;
-	int width = image->width;
-	int height = image->height;
-	int min_len = 8;
-	if (width < min_len || height < min_len)
+	}
+	int mode = arith | zerotree << 1 | scan << 6;
+	if (keyint)
+		return encode_sequence(argv[1], argv[2], keyint, mode, transform, wavelet, levels, min_len);
+	struct picture *picture = 0;
+	struct stripe_reader *stripes = 0;
+	FILE *file = 0;
+	if (pipelined) {
+		const char *fname = "/dev/stdin";
+		if (argv[1][0] != '-' || argv[1][1])
+			fname = argv[1];
+		if (!(file = fopen(fname, "r"))) {
+			fprintf(stderr, "could not open \"%s\" file to read.\n", fname);
+			return 1;
+		}
+		picture = read_pnm_header(file, fname);
+		if (picture && valid_size(picture->width, picture->height) && !(stripes = stripe_reader(file, fname, picture)))
+			return 1;
+	} else {
+		picture = read_pnm(argv[1]);
+	}
+	if (!picture || !valid_size(picture->width, picture->height))
 		return 1;
-	int total = width * height;
-	int lengths[16], pixels[16], widths[16], heights[16];
-	int levels = compute_lengths(lengths, pixels, widths, heights, width, height, min_len);
-	int capacity = 0;
+	long long capacity = 0;
 	if (argc >= 4)
-		capacity = atoi(argv[3]);
-	int channels = image->channels;
-	int color = channels == 3;
-	if (color)
-		ycocg_from_rgb(image);
-	int *temp = malloc(sizeof(int) * channels * total);
-	int *buffer = malloc(sizeof(int) * channels * total);
-	transformation(temp, image->buffer, min_len, width, height, 1, 1, width * channels, channels);
-	linearization(buffer, temp, widths, heights, lengths, levels, channels);
-	delete_image(image);
-	free(temp);
-	int planes[channels];
-	for (int chan = 0; chan < channels; ++chan)
-		planes[chan] = process(buffer + chan * total + pixels[0], total - pixels[0]);
+		capacity = atoll(argv[3]);
+	int width = picture->width, height = picture->height, channels = picture->channels;
+	if (transform >= 0 && !valid_transform(transform, channels))
+		transform = 0;
+	else if (transform < 0 && !stripes)
+		transform = choose_transform(picture);
+	int *buffers[MAX_CHANNELS];
+	if (stripes) {
+		levels = prepare_stripes(buffers, picture, stripes, &transform, wavelet, levels, min_len);
+		delete_stripe_reader(stripes);
+		fclose(file);
+		if (levels < 0)
+			return 1;
+	} else {
+		levels = prepare(buffers, picture, transform, wavelet, levels, min_len);
+	}
+	delete_picture(picture);
 	struct bytes_writer *bytes = bytes_writer(argv[2], capacity);
-	if (!bytes)
+	if (!bytes || (pipelined && bytes_writer_thread(bytes)))
 		return 1;
-	put_byte(bytes, 'W');
-	put_byte(bytes, color ? '6' : '5');
-	write_bytes(bytes, width - 1, 2);
-	write_bytes(bytes, height - 1, 2);
-	struct bits_writer *bits = bits_writer(bytes);
-	struct vli_writer *vli = vli_writer(bits);
-	int meta_data = bits_count(bits);
-	fprintf(stderr, "%d bits for meta data\n", meta_data);
-	for (int chan = 0; chan < channels; ++chan)
-		encode_root(vli, buffer + chan * total, pixels[0]);
-	int root_image = bits_count(bits);
-	fprintf(stderr, "%d bits for root image\n", root_image - meta_data);
-	for (int chan = 0; chan < channels; ++chan)
-		put_vli(vli, planes[chan]);
-	int planes_max = 0;
-	for (int chan = 0; chan < channels; ++chan)
-		if (planes_max < planes[chan])
-			planes_max = planes[chan];
-	int maximum = levels > planes_max ? levels : planes_max;
-	int layers_max = 2 * maximum - 1;
-	struct rle_writer *rle = rle_writer(vli);
-	if (planes_max == planes[0]) {
-		int num = pixels[1] - pixels[0];
-		if (encode_plane(rle, buffer + pixels[0], num, planes[0] - 1))
-			goto end;
-	}
-	for (int layers = 0; layers < layers_max; ++layers) {
-		for (int l = 0, *buf = buffer + pixels[0],
-			num = pixels[l + 1] - pixels[l];
-			l < levels && l <= layers + 1; buf += num, ++l,
-			num = pixels[l + 1] - pixels[l]) {
-			for (int chan = 0; chan < 1; ++chan) {
-				int plane = planes_max - 1 - (layers + 1 - l);
-				if (plane < 0 || plane >= planes[chan])
-					continue;
-				if (encode_plane(rle, buf + chan * total, num, plane))
-					goto end;
-			}
-		}
-		for (int l = 0, *buf = buffer + pixels[0],
-			num = pixels[l + 1] - pixels[l];
-			l < levels && l <= layers; buf += num, ++l,
-			num = pixels[l + 1] - pixels[l]) {
-			for (int chan = 1; chan < channels; ++chan) {
-				int plane = planes_max - 1 - (layers - l);
-				if (plane < 0 || plane >= planes[chan])
-					continue;
-				if (encode_plane(rle, buf + chan * total, num, plane))
-					goto end;
-			}
-		}
+	struct bytes_writer *index = 0;
+	if (index_name) {
+		if (!(index = bytes_writer(index_name, 0)))
+			return 1;
+		write_index_header(index);
 	}
-	rle_flush(rle);
-end:
-	delete_rle_writer(rle);
-	delete_vli_writer(vli);
-	free(buffer);
-	int cnt = bits_count(bits);
-	close_bits_writer(bits);
-	int kib = (bytes_count(bytes) + 512) / 1024;
+	analysis(buffers, width, height, channels, scan, wavelet, levels, budget, pipelined);
+	encode(bytes, index, buffers, width, height, channels, 0, mode | transform << 3, wavelet, levels, budget, budget, 0);
+	if (index)
+		close_bytes_writer(index);
+	for (int chan = 0; chan < channels; ++chan)
+		free(buffers[chan]);
+	long long kib = (bytes_count(bytes) + 512) / 1024;
 	close_bytes_writer(bytes);
-	fprintf(stderr, "%d bits (%d KiB) encoded\n", cnt, kib);
+	fprintf(stderr, "%lld KiB encoded\n", kib);
 	return 0;
 }
-
@@ -0,0 +1,511 @@
+/*
+Encoding of wavelet coefficients into an embedded stream
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "layout.h"
+#include "wavelet.h"
+#include "utils.h"
+#include "tree.h"
+#include "index.h"
+#include "image.h"
+#include "entropy.h"
+#include "rle.h"
+#include "vli.h"
+#include "bits.h"
+#include "bytes.h"
+#include "alloc.h"
+
+void forward_transformation(int *val, int levels, int W, int H, int S, int SW, struct wavelet *wavelet, int lifted)
+{
+	for (int j = 0; !lifted && j < H; ++j)
+		wavelet->row(val + S * SW * j, W, S, 1, 1);
+	wavelet_columns(wavelet, val, H, S * SW, W, S);
+	if (levels > 1)
+		forward_transformation(val, levels - 1, (W + 1) / 2, (H + 1) / 2, 2 * S, SW, wavelet, 0);
+}
+
+long long estimate_root(int *val, int W, int H, int SW, int S)
+{
+	long long bits = 0;
+	for (int j = 0; j < H; ++j) {
+		for (int i = 0; i < W; ++i) {
+			int res = val[(SW * j + i) * S] - median_predictor(val, i, j, SW, S);
+			bits += 3 + ilog2(abs(res));
+		}
+	}
+	return bits;
+}
+
+long long estimate_detail(int *val, int W, int H, int SW, int S)
+{
+	long long bits = 0;
+	for (int j = 0; j < H; ++j)
+		for (int i = !(j & 1); i < W; i += 1 + !(j & 1))
+			if (val[(SW * j + i) * S])
+				bits += 2 + ilog2(abs(val[(SW * j + i) * S]));
+	return bits;
+}
+
+void downsample(int *small, int **planes, int width, int height, int channels, int first, int last)
+{
+	int W = (width + 3) / 4, H = (height + 3) / 4;
+	for (int c = 0; c < channels; ++c)
+		for (int y = first; y < last; ++y)
+			for (int x = 0; x < width; ++x)
+				small[W * H * c + W * (y / 4) + x / 4] += planes[c][width * y + x];
+}
+
+int choose_levels(int *small, int width, int height, int channels, int levels_max, struct wavelet *wavelet)
+{
+	int W = (width + 3) / 4, H = (height + 3) / 4;
+	for (int c = 0; c < channels; ++c) {
+		for (int j = 0; j < H; ++j) {
+			for (int i = 0; i < W; ++i) {
+				int cnt = (height - 4 * j < 4 ? height - 4 * j : 4) * (width - 4 * i < 4 ? width - 4 * i : 4);
+				small[W * H * c + W * j + i] /= cnt;
+			}
+		}
+	}
+	int best = 2;
+	long long detail = 0, best_bits = 0;
+	for (int c = 0; c < channels; ++c)
+		best_bits += estimate_root(small + W * H * c, W, H, W, 1);
+	for (int levels = 3, w = W, h = H, S = 1; levels <= levels_max; ++levels, S *= 2) {
+		for (int c = 0; c < channels; ++c) {
+			forward_transformation(small + W * H * c, 1, w, h, S, W, wavelet, 0);
+			detail += estimate_detail(small + W * H * c, w, h, W, S);
+		}
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+		long long bits = detail;
+		for (int c = 0; c < channels; ++c)
+			bits += estimate_root(small + W * H * c, w, h, W, 2 * S);
+		if (bits < best_bits) {
+			best_bits = bits;
+			best = levels;
+		}
+	}
+	return best;
+}
+
+int choose_transform(struct picture *picture)
+{
+	int channels = picture->channels;
+	if (channels == 1)
+		return 0;
+	int width = picture->width, height = picture->height;
+	int W = (width + 3) / 4, H = (height + 3) / 4;
+	int *small = malloc(sizeof(int) * W * H * channels);
+	int best = 0;
+	long long best_bits = 0;
+	for (int transform = 0; transform < TRANSFORMS; ++transform) {
+		if (!valid_transform(transform, channels))
+			continue;
+		for (int j = 0; j < H; ++j) {
+			for (int i = 0; i < W; ++i) {
+				int io[MAX_CHANNELS];
+				for (int c = 0; c < channels; ++c)
+					io[c] = picture->buffer[channels * ((size_t)width * 4 * j + 4 * i) + c];
+				if (channels == 3)
+					transforms[transform](io);
+				else if (transform == TRANSFORM_DELTA)
+					bands2delta(io, channels);
+				for (int c = 0; c < channels; ++c)
+					small[W * H * c + W * j + i] = io[c];
+			}
+		}
+		long long bits = 0;
+		for (int c = 0; c < channels; ++c)
+			bits += estimate_root(small + W * H * c, W, H, W, 1);
+		if (!transform || bits < best_bits) {
+			best_bits = bits;
+			best = transform;
+		}
+	}
+	free(small);
+	return best;
+}
+
+long long xlog2(long long x)
+{
+	if (x < 2)
+		return 0;
+	int e = 0;
+	while (x >> (e + 1))
+		++e;
+	unsigned long long y = (unsigned long long)x << 30 >> e;
+	int frac = 0;
+	for (int b = 0; b < 8; ++b) {
+		y = y * y >> 30;
+		frac <<= 1;
+		if (y >> 31) {
+			frac |= 1;
+			y >>= 1;
+		}
+	}
+	return x * (e << 8 | frac);
+}
+
+long long binary_cost(long long n, long long k)
+{
+	return xlog2(n) - xlog2(k) - xlog2(n - k);
+}
+
+void descendants(unsigned char *desc, int *count, unsigned char *use, int arith, int *val, int *par, int *pixels, int levels, int base, int *planes)
+{
+	int int_bits = sizeof(int) * 8;
+	int ref_pos = int_bits - 3;
+	int ref_mask = 1 << ref_pos;
+	for (int i = 0; i < pixels[levels]; ++i)
+		desc[i] = count[i] = 0;
+	int coded[MAX_LEVELS + 1] = { 0 }, significant[MAX_LEVELS + 1] = { 0 };
+	for (int l = levels - 1, plane = base + l; l > 0; --l, --plane) {
+		coded[l] = coded[l + 1];
+		significant[l] = significant[l + 1];
+		if (plane <= 0 || plane >= planes[l])
+			continue;
+		for (int i = pixels[l]; i < pixels[l + 1]; ++i) {
+			int sig = !(val[i] & ref_mask) && (val[i] & (1 << plane));
+			if (desc[i] || sig)
+				desc[par[i]] = 1;
+			count[par[i]] += count[i] + !(val[i] & ref_mask);
+			coded[l] += !(val[i] & ref_mask);
+			significant[l] += sig;
+		}
+	}
+	for (int l = 0, plane = base; l + 1 < levels; ++l, ++plane) {
+		use[l] = 0;
+		if (plane < 0 || plane >= planes[l] || plane + 1 >= planes[l + 1])
+			continue;
+		int symbols = 0, roots = 0, skipped = 0, sigs = 0;
+		for (int i = pixels[l]; i < pixels[l + 1]; ++i) {
+			if (val[i] & ref_mask)
+				continue;
+			if (val[i] & (1 << plane)) {
+				++sigs;
+			} else {
+				++symbols;
+				if (!desc[i]) {
+					++roots;
+					skipped += count[i];
+				}
+			}
+		}
+		int n = coded[l + 1], k = significant[l + 1];
+		long long gain = binary_cost(n, k) - binary_cost(n - skipped, k);
+		long long cost = binary_cost(symbols, roots);
+		if (!arith)
+			cost = binary_cost(2LL * symbols + sigs, symbols - roots + sigs) - binary_cost(symbols + sigs, sigs);
+		use[l] = gain > cost + cost / 4;
+	}
+}
+
+int encode_plane(struct entropy_writer *ent, int *chn, int *par, unsigned char *tree, unsigned char *desc, int off, int num, int plane, int kids, int use, int ctx)
+{
+	int *val = chn + off;
+	int bit_mask = 1 << plane;
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	int mix_mask = sgn_mask | sig_mask | ref_mask;
+	if (tree && kids) {
+		int ret = entropy_put_bit(ent, use, ctx + CONTEXT_TREE);
+		if (ret)
+			return ret;
+		kids = use;
+	}
+	for (int i = 0; i < num; ++i) {
+		if (tree) {
+			int cov = plane > 0 && par[off + i] >= 0 && tree[par[off + i]];
+			tree[off + i] = cov;
+			if (cov)
+				continue;
+		}
+		if (!(val[i] & ref_mask)) {
+			int bit = val[i] & bit_mask;
+			int sig = ctx + CONTEXT_SIG;
+			if (ent->arith) {
+				sig += i > 0 && (val[i - 1] & (sig_mask | ref_mask));
+				sig += i + 1 < num && (val[i + 1] & ref_mask);
+				if (par[off + i] >= 0 && (chn[par[off + i]] & ~mix_mask) >> plane)
+					sig += 3;
+			}
+			int ret = entropy_put_sig(ent, bit, sig);
+			if (ret)
+				return ret;
+			if (bit) {
+				int ret = entropy_put_bit(ent, val[i] & sgn_mask, ctx + CONTEXT_SGN);
+				if (ret)
+					return ret;
+				val[i] |= sig_mask;
+			} else if (tree && kids) {
+				int ret = entropy_put_sig(ent, desc[off + i], ctx + CONTEXT_ZTR);
+				if (ret)
+					return ret;
+				tree[off + i] = !desc[off + i];
+			}
+		}
+	}
+	for (int i = 0; i < num; ++i) {
+		if (val[i] & ref_mask) {
+			int bit = val[i] & bit_mask;
+			int ref = ctx + CONTEXT_REF + ((val[i] & ~mix_mask) >> (plane + 1) == 1);
+			int ret = entropy_put_bit(ent, bit, ref);
+			if (ret)
+				return ret;
+		} else if (val[i] & sig_mask) {
+			val[i] ^= sig_mask | ref_mask;
+		}
+	}
+	return entropy_put_end(ent, ctx);
+}
+
+int encode_root(struct vli_writer *vli, int *val, int W, int H)
+{
+	for (int j = 0; j < H; ++j) {
+		for (int i = 0; i < W; ++i) {
+			int res = val[W * j + i] - median_predictor(val, i, j, W, 1);
+			int ret = put_vli(vli, res < 0 ? -2 * res - 1 : 2 * res);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
+int sign_magnitude(int *val, int num)
+{
+	int max = 0;
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	int mix_mask = sgn_mask | sig_mask | ref_mask;
+	for (int i = 0; i < num; ++i) {
+		int sgn = val[i] < 0;
+		int mag = abs(val[i]);
+		if (max < mag)
+			max = mag;
+		val[i] = (sgn << sgn_pos) | (mag & ~mix_mask);
+	}
+	return 1 + ilog2(max);
+}
+
+int mark_layer(struct bytes_writer *index, struct bits_writer *bits, struct entropy_writer *ent)
+{
+	if (!index)
+		return 0;
+	struct layer_index idx = { bits_count(bits), { 0 } };
+	if (ent->arith)
+		idx.offset = 8 * arith_count(ent->arith);
+	else
+		for (int i = 0; i < RLE_CONTEXTS; ++i)
+			idx.orders[i] = ent->rle[i]->vli->order;
+	return write_index(index, &idx);
+}
+
+struct analysis_job {
+	int *val, levels, width, height, lifted;
+	struct wavelet *wavelet;
+};
+
+void *analysis_loop(void *data)
+{
+	struct analysis_job *job = data;
+	forward_transformation(job->val, job->levels, job->width, job->height, 1, job->width, job->wavelet, job->lifted);
+	return 0;
+}
+
+void analysis(int **buffers, int width, int height, int channels, int scan, int wavelet, int levels, int budget, int lifted)
+{
+	int total = width * height;
+	int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+	compute_lengths(lengths, pixels, widths, heights, width, height, levels);
+	int reach = budget && budget < levels ? budget + 1 : levels;
+	struct analysis_job jobs[MAX_CHANNELS];
+	pthread_t threads[MAX_CHANNELS];
+	int started[MAX_CHANNELS];
+	for (int chan = channels - 1; chan >= 0; --chan) {
+		jobs[chan] = (struct analysis_job){ buffers[chan], levels, width, height, lifted, wavelets + wavelet };
+		started[chan] = BAND_THREADS && chan && !pthread_create(threads + chan, 0, analysis_loop, jobs + chan);
+		if (!started[chan])
+			analysis_loop(jobs + chan);
+	}
+	int *order = alloc_frame(sizeof(int) * total);
+	compute_order(order, widths, heights, lengths, levels, reach, scan);
+	int *temp = alloc_frame(sizeof(int) * total);
+	for (int chan = 0; chan < channels; ++chan) {
+		if (started[chan])
+			pthread_join(threads[chan], 0);
+		gather(temp, buffers[chan], order, total);
+		int *swap = buffers[chan];
+		buffers[chan] = temp;
+		temp = swap;
+	}
+	free(temp);
+	free(order);
+}
+
+int encode(struct bytes_writer *bytes, struct bytes_writer *index, int **buffers, int width, int height, int channels, int *reference, int mode, int wavelet, int levels, int budget, int end, int *known)
+{
+	int arith = mode & 1;
+	int zerotree = mode >> 1 & 1;
+	int temporal = mode >> 2 & 1;
+	int scan = mode >> 6 & 1;
+	int total = width * height;
+	int color = channels == 3;
+	int multi = channels != 1 && !color;
+	long long start = 8 * bytes_count(bytes);
+	int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+	compute_lengths(lengths, pixels, widths, heights, width, height, levels);
+	int reach = budget && budget < levels ? budget + 1 : levels;
+	for (int chan = 0; reference && chan < channels; ++chan) {
+		for (int i = 0; i < total; ++i) {
+			int val = buffers[chan][i];
+			if (temporal)
+				buffers[chan][i] -= reference[(size_t)total * chan + i];
+			reference[(size_t)total * chan + i] = val;
+		}
+	}
+	int planes[channels * MAX_LEVELS], chan_max[channels];
+	for (int chan = 0; chan < channels; ++chan) {
+		chan_max[chan] = 0;
+		for (int l = 0; l < levels; ++l) {
+			int *plns = planes + chan * MAX_LEVELS;
+			plns[l] = l < reach ? sign_magnitude(buffers[chan] + pixels[l], pixels[l + 1] - pixels[l]) : 0;
+			if (known && l < reach)
+				plns[l] = known[chan * MAX_LEVELS + l];
+			if (chan_max[chan] < plns[l])
+				chan_max[chan] = plns[l];
+		}
+	}
+	int planes_max = 0;
+	for (int chan = 0; chan < channels; ++chan)
+		if (planes_max < chan_max[chan])
+			planes_max = chan_max[chan];
+	int maximum = levels > planes_max ? levels : planes_max;
+	int layers_max = 2 * maximum - 1;
+	int rest = 0;
+	for (int chan = 0; chan < channels; ++chan)
+		for (int l = 0; l < levels; ++l)
+			if (planes[chan * MAX_LEVELS + l] && planes_max - 2 + l + !!chan >= end)
+				rest = 1;
+	if (!rest)
+		end = 0;
+	int large = multi || width > 65536 || height > 65536;
+	put_byte(bytes, 'W');
+	put_byte(bytes, 'V');
+	put_byte(bytes, LAYOUT_VERSION);
+	put_byte(bytes, multi ? '9' : (color ? '6' : '5') + 2 * large);
+	if (multi)
+		put_byte(bytes, channels);
+	write_bytes(bytes, width - 1, 2 + 2 * large);
+	write_bytes(bytes, height - 1, 2 + 2 * large);
+	put_byte(bytes, mode);
+	put_byte(bytes, wavelet);
+	put_byte(bytes, levels);
+	put_byte(bytes, end);
+	struct bits_writer *bits = bits_writer(bytes);
+	struct vli_writer *vli = vli_writer(bits);
+	long long meta_data = bits_count(bits) - start;
+	fprintf(stderr, "%lld bits for meta data\n", meta_data);
+	for (int chan = 0; chan < channels; ++chan)
+		encode_root(vli, buffers[chan], widths[0], heights[0]);
+	long long root_image = bits_count(bits) - start;
+	fprintf(stderr, "%lld bits for root image\n", root_image - meta_data);
+	for (int chan = 0; chan < channels; ++chan) {
+		put_vli(vli, chan_max[chan]);
+		for (int l = 0; l < levels; ++l)
+			put_vli(vli, chan_max[chan] - planes[chan * MAX_LEVELS + l]);
+	}
+	if (budget && budget < layers_max)
+		layers_max = budget;
+	int *parents = 0;
+	if (arith || zerotree) {
+		parents = alloc_frame(sizeof(int) * total);
+		compute_parents(parents, widths, heights, lengths, reach, scan);
+	}
+	unsigned char *trees[MAX_CHANNELS] = { 0 }, *desc[MAX_CHANNELS] = { 0 }, use[MAX_CHANNELS * MAX_LEVELS] = { 0 };
+	int *count = zerotree ? alloc_frame(sizeof(int) * total) : 0;
+	for (int chan = 0; zerotree && chan < channels; ++chan) {
+		trees[chan] = calloc(total, 1);
+		desc[chan] = malloc(total);
+	}
+	struct arith_writer *ac = 0;
+	if (arith) {
+		bits_flush(bits);
+		ac = arith_writer(bytes);
+	}
+	int ret = 0;
+	struct entropy_writer *ent = entropy_writer(bits, ac);
+	mark_layer(index, bits, ent);
+	if (planes_max == planes[0]) {
+		int num = pixels[1] - pixels[0];
+		if ((ret = encode_plane(ent, buffers[0], parents, trees[0], desc[0], pixels[0], num, planes_max - 1, 0, 0, entropy_context(0, 0))))
+			goto end;
+	}
+	for (int layers = 0; layers < layers_max; ++layers) {
+		if (zerotree)
+			for (int chan = 0; chan < channels; ++chan)
+				descendants(desc[chan], count, use + chan * MAX_LEVELS, arith, buffers[chan], parents, pixels, reach, planes_max - 1 - (layers + !chan), planes + chan * MAX_LEVELS);
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers + 1; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			for (int chan = 0; chan < 1; ++chan) {
+				int plane = planes_max - 1 - (layers + 1 - l);
+				int *plns = planes + chan * MAX_LEVELS;
+				if (plane < 0 || plane >= plns[l])
+					continue;
+				int kids = l + 1 < levels && plane + 1 < plns[l + 1];
+				if ((ret = encode_plane(ent, buffers[chan], parents, trees[chan], desc[chan], off, num, plane, kids, use[chan * MAX_LEVELS + l], entropy_context(chan, l))))
+					goto end;
+			}
+		}
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			for (int chan = 1; chan < channels; ++chan) {
+				int plane = planes_max - 1 - (layers - l);
+				int *plns = planes + chan * MAX_LEVELS;
+				if (plane < 0 || plane >= plns[l])
+					continue;
+				int kids = l + 1 < levels && plane + 1 < plns[l + 1];
+				if ((ret = encode_plane(ent, buffers[chan], parents, trees[chan], desc[chan], off, num, plane, kids, use[chan * MAX_LEVELS + l], entropy_context(chan, l))))
+					goto end;
+			}
+		}
+		mark_layer(index, bits, ent);
+	}
+	ret = entropy_flush(ent);
+end:
+	delete_entropy_writer(ent);
+	if (ac)
+		delete_arith_writer(ac);
+	delete_vli_writer(vli);
+	free(parents);
+	free(count);
+	for (int chan = 0; chan < channels; ++chan) {
+		free(trees[chan]);
+		free(desc[chan]);
+	}
+	long long cnt = bits_count(bits) - start;
+	close_bits_writer(bits);
+	fprintf(stderr, "%lld bits encoded\n", cnt);
+	return ret;
+}
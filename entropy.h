@@ -0,0 +1,133 @@
+/*
+Entropy coding of significance, sign and refinement bits
+
+Either run length encoding with an adaptive Rice coder per channel and level
+or context adaptive binary range coding
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include "arith.h"
+#include "utils.h"
+#include "rle.h"
+
+#define CONTEXTS_LEVEL 16
+#define CONTEXTS_CHANNEL (MAX_LEVELS * CONTEXTS_LEVEL)
+#define CONTEXTS (2 * CONTEXTS_CHANNEL)
+#define RLE_CONTEXTS (CONTEXTS / CONTEXTS_LEVEL)
+#define CONTEXT_SIG 0
+#define CONTEXT_SGN 6
+#define CONTEXT_REF 7
+#define CONTEXT_ZTR 9
+#define CONTEXT_TREE 10
+
+struct entropy_reader {
+	struct rle_reader *rle[RLE_CONTEXTS];
+	struct arith_reader *arith;
+	uint16_t probs[CONTEXTS];
+};
+
+struct entropy_writer {
+	struct rle_writer *rle[RLE_CONTEXTS];
+	struct arith_writer *arith;
+	uint16_t probs[CONTEXTS];
+};
+
+int entropy_context(int chan, int level)
+{
+	return (chan ? CONTEXTS_CHANNEL : 0) + level * CONTEXTS_LEVEL;
+}
+
+struct entropy_reader *entropy_reader(struct bits_reader *bits, struct arith_reader *arith)
+{
+	struct entropy_reader *ent = malloc(sizeof(struct entropy_reader));
+	for (int i = 0; i < RLE_CONTEXTS; ++i)
+		ent->rle[i] = rle_reader(vli_reader(bits));
+	ent->arith = arith;
+	arith_contexts(ent->probs, CONTEXTS);
+	return ent;
+}
+
+struct entropy_writer *entropy_writer(struct bits_writer *bits, struct arith_writer *arith)
+{
+	struct entropy_writer *ent = malloc(sizeof(struct entropy_writer));
+	for (int i = 0; i < RLE_CONTEXTS; ++i)
+		ent->rle[i] = rle_writer(vli_writer(bits));
+	ent->arith = arith;
+	arith_contexts(ent->probs, CONTEXTS);
+	return ent;
+}
+
+int entropy_flush(struct entropy_writer *ent)
+{
+	if (ent->arith)
+		return arith_flush(ent->arith);
+	for (int i = 0; i < RLE_CONTEXTS; ++i) {
+		int ret = rle_flush(ent->rle[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+void delete_entropy_reader(struct entropy_reader *ent)
+{
+	for (int i = 0; i < RLE_CONTEXTS; ++i) {
+		delete_vli_reader(ent->rle[i]->vli);
+		delete_rle_reader(ent->rle[i]);
+	}
+	free(ent);
+}
+
+void delete_entropy_writer(struct entropy_writer *ent)
+{
+	for (int i = 0; i < RLE_CONTEXTS; ++i) {
+		delete_vli_writer(ent->rle[i]->vli);
+		delete_rle_writer(ent->rle[i]);
+	}
+	free(ent);
+}
+
+int entropy_put_end(struct entropy_writer *ent, int ctx)
+{
+	if (ent->arith)
+		return 0;
+	return rle_flush(ent->rle[ctx / CONTEXTS_LEVEL]);
+}
+
+int entropy_get_end(struct entropy_reader *ent, int ctx)
+{
+	if (ent->arith)
+		return 0;
+	return rle_drain(ent->rle[ctx / CONTEXTS_LEVEL]);
+}
+
+int entropy_put_sig(struct entropy_writer *ent, int bit, int ctx)
+{
+	if (ent->arith)
+		return put_arith(ent->arith, bit, ent->probs + ctx);
+	return put_rle(ent->rle[ctx / CONTEXTS_LEVEL], bit);
+}
+
+int entropy_get_sig(struct entropy_reader *ent, int ctx)
+{
+	if (ent->arith)
+		return get_arith(ent->arith, ent->probs + ctx);
+	return get_rle(ent->rle[ctx / CONTEXTS_LEVEL]);
+}
+
+int entropy_put_bit(struct entropy_writer *ent, int bit, int ctx)
+{
+	if (ent->arith)
+		return put_arith(ent->arith, bit, ent->probs + ctx);
+	return rle_put_bit(ent->rle[ctx / CONTEXTS_LEVEL], bit);
+}
+
+int entropy_get_bit(struct entropy_reader *ent, int ctx)
+{
+	if (ent->arith)
+		return get_arith(ent->arith, ent->probs + ctx);
+	return rle_get_bit(ent->rle[ctx / CONTEXTS_LEVEL]);
+}
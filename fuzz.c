@@ -0,0 +1,61 @@
+/*
+Fuzzing entry point for the decoder
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include "decoder.h"
+
+#define FUZZ_PIXELS (1 << 20)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if (size < 12 || data[0] != 'W' || data[1] != 'V' || data[3] < '5' || data[3] > '9')
+		return 0;
+	int large = data[3] > '6';
+	int multi = data[3] == '9';
+	if (large && size < 16u + multi)
+		return 0;
+	long long width = 1, height = 1;
+	for (int i = 0; i < 2 + 2 * large; ++i) {
+		width += (long long)data[4 + multi + i] << (8 * i);
+		height += (long long)data[6 + multi + 2 * large + i] << (8 * i);
+	}
+	int channels = multi ? data[4] : 3;
+	if (width * height * channels > 3 * FUZZ_PIXELS)
+		return 0;
+	FILE *file = fmemopen((void *)data, size, "r");
+	if (!file)
+		return 0;
+	struct bytes_reader bytes = { file, "fuzz", BYTES_SUM };
+	get_byte(&bytes);
+	int number = get_byte(&bytes);
+	struct picture *picture = decode(&bytes, number, 0, -1, -1, 0, 0);
+	if (picture)
+		delete_picture(picture);
+	fclose(file);
+	return 0;
+}
+
+#ifdef FUZZ_MAIN
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		FILE *file = fopen(argv[i], "r");
+		if (!file) {
+			fprintf(stderr, "could not open \"%s\" file to read\n", argv[i]);
+			return 1;
+		}
+		size_t size = 0, cap = 4096;
+		uint8_t *data = malloc(cap);
+		for (size_t n; (n = fread(data + size, 1, cap - size, file)); size += n)
+			if (size + n == cap)
+				data = realloc(data, cap *= 2);
+		fclose(file);
+		LLVMFuzzerTestOneInput(data, size);
+		free(data);
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,30 @@
+/*
+Reversible integer Haar wavelet also known as S-transform
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+void haar(int *val, int N, int S, int CH, int SC)
+{
+	for (int i = 0; i < (N & ~1); i += 2) {
+		for (int c = 0; c < CH; ++c) {
+			int d = val[(i + 1) * S + c * SC] - val[i * S + c * SC];
+			val[i * S + c * SC] += d >> 1;
+			val[(i + 1) * S + c * SC] = d;
+		}
+	}
+}
+
+void ihaar(int *val, int N, int S, int CH, int SC)
+{
+	for (int i = 0; i < (N & ~1); i += 2) {
+		for (int c = 0; c < CH; ++c) {
+			int d = val[(i + 1) * S + c * SC];
+			int s = val[i * S + c * SC] - (d >> 1);
+			val[i * S + c * SC] = s;
+			val[(i + 1) * S + c * SC] = s + d;
+		}
+	}
+}
@@ -7,12 +7,14 @@ https://en.wikipedia.org/wiki/Hilbert_curve
 Copyright 2021 Ahmet Inan <xdsopl@gmail.com>
 */
 
+#pragma once
+
 struct position
 {
 	int x, y;
 };
 
-struct position hilbert(int n, int d)
+struct position hilbert(int n, long long d)
 {
 	int x = 0, y = 0;
 	for (int s = 1; s < n; s *= 2, d /= 4) {
@@ -32,4 +34,3 @@ struct position hilbert(int n, int d)
 	}
 	return (struct position) { x, y };
 }
-
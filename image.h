@@ -7,28 +7,34 @@ Copyright 2014 Ahmet Inan <xdsopl@gmail.com>
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
-struct image {
-	int *buffer;
+#define MAX_CHANNELS 16
+#define TRANSFORMS 5
+#define TRANSFORM_DELTA 4
+
+struct picture {
+	uint8_t *buffer;
 	int width, height, total, channels;
 };
 
-void delete_image(struct image *image)
+void delete_picture(struct picture *picture)
 {
-	free(image->buffer);
-	free(image);
+	free(picture->buffer);
+	free(picture);
 }
 
-struct image *new_image(int width, int height, int channels)
+struct picture *new_picture(int width, int height, int channels)
 {
-	struct image *image = malloc(sizeof(struct image));
-	image->height = height;
-	image->width = width;
-	image->total = width * height;
-	image->channels = channels;
-	image->buffer = malloc(channels * sizeof(int) * width * height);
-	return image;
+	struct picture *picture = malloc(sizeof(struct picture));
+	picture->height = height;
+	picture->width = width;
+	picture->total = width * height;
+	picture->channels = channels;
+	picture->buffer = malloc((size_t)channels * width * height);
+	return picture;
 }
 
 int clamp_image(int x, int a, int b)
@@ -64,17 +70,125 @@ void rgb2ycocg(int *io)
 	io[2] = V;
 }
 
-void ycocg_from_rgb(struct image *image)
+void rct2rgb(int *io)
 {
-	assert(image->channels == 3);
-	for (int i = 0; i < image->total; i++)
-		rgb2ycocg(image->buffer + 3 * i);
+	int Y = clamp_image(io[0], 0, 255);
+	int U = clamp_image(io[1], -255, 255);
+	int V = clamp_image(io[2], -255, 255);
+	int G = Y - ((U + V) >> 2);
+	io[0] = V + G;
+	io[1] = G;
+	io[2] = U + G;
+}
+
+void rgb2rct(int *io)
+{
+	int R = io[0];
+	int G = io[1];
+	int B = io[2];
+	int U = B - G;
+	int V = R - G;
+	io[0] = G + ((U + V) >> 2);
+	io[1] = U;
+	io[2] = V;
+}
+
+void green2rgb(int *io)
+{
+	int G = clamp_image(io[0], 0, 255);
+	int U = clamp_image(io[1], -255, 255);
+	int V = clamp_image(io[2], -255, 255);
+	io[0] = U + G;
+	io[1] = G;
+	io[2] = V + G;
+}
+
+void rgb2green(int *io)
+{
+	int R = io[0];
+	int G = io[1];
+	int B = io[2];
+	io[0] = G;
+	io[1] = R - G;
+	io[2] = B - G;
 }
 
-void rgb_from_ycocg(struct image *image)
+void delta2bands(int *io, int CH)
 {
-	assert(image->channels == 3);
-	for (int i = 0; i < image->total; i++)
-		ycocg2rgb(image->buffer + 3 * i);
+	io[0] = clamp_image(io[0], 0, 255);
+	for (int c = 1; c < CH; ++c)
+		io[c] = clamp_image(clamp_image(io[c], -255, 255) + io[c - 1], 0, 255);
 }
 
+void bands2delta(int *io, int CH)
+{
+	for (int c = CH - 1; c > 0; --c)
+		io[c] -= io[c - 1];
+}
+
+void delta2rgb(int *io)
+{
+	delta2bands(io, 3);
+}
+
+void rgb2delta(int *io)
+{
+	bands2delta(io, 3);
+}
+
+void rgb2rgb(int *io)
+{
+	(void)io;
+}
+
+const char *transform_names[TRANSFORMS] = { "ycocg", "none", "rct", "green", "delta" };
+void (*transforms[TRANSFORMS])(int *) = { rgb2ycocg, rgb2rgb, rgb2rct, rgb2green, rgb2delta };
+void (*inverse_transforms[TRANSFORMS])(int *) = { ycocg2rgb, rgb2rgb, rct2rgb, green2rgb, delta2rgb };
+
+int transform_index(const char *name)
+{
+	for (int i = 0; i < TRANSFORMS; ++i)
+		if (!strcmp(name, transform_names[i]))
+			return i;
+	return -1;
+}
+
+int valid_transform(int transform, int channels)
+{
+	if (channels == 3)
+		return transform >= 0 && transform < TRANSFORMS;
+	return !transform || (channels > 1 && transform == TRANSFORM_DELTA);
+}
+
+void planar_from_picture(int **planes, struct picture *picture, int transform, int first, int last)
+{
+	int channels = picture->channels;
+	void (*forward)(int *) = transforms[transform];
+	for (int i = first * picture->width; i < last * picture->width; i++) {
+		int io[MAX_CHANNELS];
+		for (int c = 0; c < channels; ++c)
+			io[c] = picture->buffer[(size_t)channels * i + c];
+		if (channels == 3)
+			forward(io);
+		else if (transform == TRANSFORM_DELTA)
+			bands2delta(io, channels);
+		for (int c = 0; c < channels; ++c)
+			planes[c][i] = io[c];
+	}
+}
+
+void narrow_row(uint8_t *output, int **rows, int S, int width, int channels, int transform)
+{
+	void (*inverse)(int *) = inverse_transforms[transform];
+	for (int i = 0; i < width; ++i) {
+		int io[MAX_CHANNELS];
+		for (int c = 0; c < channels; ++c)
+			io[c] = rows[c][S * i];
+		if (channels == 3)
+			inverse(io);
+		else if (transform == TRANSFORM_DELTA)
+			delta2bands(io, channels);
+		for (int c = 0; c < channels; ++c)
+			output[channels * i + c] = clamp_image(io[c], 0, 255);
+	}
+}
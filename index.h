@@ -0,0 +1,34 @@
+/*
+Index of bit offsets and coder states at layer boundaries
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include "bytes.h"
+#include "entropy.h"
+
+struct layer_index {
+	long long offset;
+	int orders[RLE_CONTEXTS];
+};
+
+int write_index_header(struct bytes_writer *bytes)
+{
+	int ret = put_byte(bytes, 'W');
+	if (ret)
+		return ret;
+	return put_byte(bytes, 'X');
+}
+
+int write_index(struct bytes_writer *bytes, struct layer_index *idx)
+{
+	int ret;
+	if ((ret = write_bytes(bytes, idx->offset, 8)))
+		return ret;
+	for (int i = 0; i < RLE_CONTEXTS; ++i)
+		if ((ret = put_byte(bytes, idx->orders[i])))
+			return ret;
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+Mapping between the scan order and the in-place layout of the coefficients
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include "scan.h"
+
+int interleave(int x, int half, int shift)
+{
+	return (x < half ? 2 * x : 2 * (x - half) + 1) << shift;
+}
+
+void compute_order(int *order, int *widths, int *heights, int *lengths, int levels, int reach, int scan)
+{
+	int width = widths[levels];
+	int total = width * heights[levels];
+	int count = 0;
+	for (int y = 0; y < heights[0]; ++y)
+		for (int x = 0; x < widths[0]; ++x)
+			order[count++] = (width * y + x) << levels;
+	for (int l = 0; l < reach; ++l) {
+		int shift = levels - 1 - l;
+		long long d = 0;
+		for (int end = widths[l + 1] * heights[l + 1]; count < end;) {
+			struct position pos = scan_next(scan, lengths[l + 1], &d, widths[l], heights[l], widths[l + 1], heights[l + 1]);
+			order[count++] = width * interleave(pos.y, heights[l], shift) + interleave(pos.x, widths[l], shift);
+		}
+	}
+	if (count < total) {
+		unsigned char *used = calloc(total, 1);
+		for (int i = 0; i < count; ++i)
+			used[order[i]] = 1;
+		for (int i = 0; i < total; ++i)
+			if (!used[i])
+				order[count++] = i;
+		free(used);
+	}
+}
+
+void gather(int *output, int *input, int *order, int num)
+{
+	for (int i = 0; i < num; ++i)
+		output[i] = input[order[i]];
+}
+
+void scatter(int *output, int *input, int *order, int num)
+{
+	for (int i = 0; i < num; ++i)
+		output[order[i]] = input[i];
+}
@@ -0,0 +1,227 @@
+/*
+Decoder for streams of the first layout, without version, mode, wavelet and levels in the header
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include "hilbert.h"
+#include "cdf53.h"
+#include "utils.h"
+#include "image.h"
+#include "rle.h"
+#include "vli.h"
+#include "bits.h"
+#include "bytes.h"
+
+#define LEGACY_MIN_LEN 8
+
+void legacy_transformation(int *val, int *temp, int W, int H, int SW)
+{
+	int W2 = (W + 1) / 2, H2 = (H + 1) / 2;
+	if (W2 >= LEGACY_MIN_LEN && H2 >= LEGACY_MIN_LEN)
+		legacy_transformation(val, temp, W2, H2, SW);
+	for (int j = 0; j < H; ++j)
+		for (int i = 0; i < W; ++i)
+			temp[SW * (j < H2 ? 2 * j : 2 * (j - H2) + 1) + i] = val[SW * j + i];
+	icdf53(temp, H, SW, W, 1);
+	for (int j = 0; j < H; ++j) {
+		for (int i = 0; i < W; ++i)
+			val[SW * j + (i < W2 ? 2 * i : 2 * (i - W2) + 1)] = temp[SW * j + i];
+		icdf53(val + SW * j, W, 1, 1, 1);
+	}
+}
+
+int legacy_value(int val, int missing)
+{
+	int int_bits = sizeof(int) * 8;
+	int sgn_mask = 1 << (int_bits - 1);
+	int mag = val & ~(sgn_mask | 3 << (int_bits - 3));
+	if (mag && missing >= 2)
+		mag += 1 << (missing - 2);
+	return val & sgn_mask ? -mag : mag;
+}
+
+void legacy_reconstruction(int *output, int *input, int *missing, int *widths, int *heights, int *lengths, int levels)
+{
+	int index = 0, width = widths[levels];
+	for (int y = 0; y < heights[0]; ++y)
+		for (int x = 0; x < widths[0]; ++x)
+			output[width * y + x] = input[index++];
+	for (int l = 0; l < levels; ++l) {
+		for (long long i = 0; i < (long long)lengths[l + 1] * lengths[l + 1]; ++i) {
+			struct position pos = hilbert(lengths[l + 1], i);
+			if ((pos.x >= widths[l] || pos.y >= heights[l]) && pos.x < widths[l + 1] && pos.y < heights[l + 1])
+				output[width * pos.y + pos.x] = legacy_value(input[index++], missing[l]);
+		}
+	}
+}
+
+int legacy_decode_plane(struct rle_reader *rle, int *val, int num, int plane)
+{
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	for (int i = 0; i < num; ++i) {
+		if (!(val[i] & ref_mask)) {
+			int bit = get_rle(rle);
+			if (bit < 0)
+				return bit;
+			val[i] |= bit << plane;
+			if (bit) {
+				int sgn = rle_get_bit(rle);
+				if (sgn < 0)
+					return sgn;
+				val[i] |= (sgn << sgn_pos) | sig_mask;
+			}
+		}
+	}
+	for (int i = 0; i < num; ++i) {
+		if (val[i] & ref_mask) {
+			int bit = rle_get_bit(rle);
+			if (bit < 0)
+				return bit;
+			val[i] |= bit << plane;
+		} else if (val[i] & sig_mask) {
+			val[i] ^= sig_mask | ref_mask;
+		}
+	}
+	return 0;
+}
+
+int legacy_decode_root(struct vli_reader *vli, int *val, int num)
+{
+	int cnt = get_vli(vli);
+	if (cnt < 0 || cnt > (int)sizeof(int) * 8 - 3)
+		return -1;
+	for (int i = 0; cnt && i < num; ++i) {
+		int ret = vli_read_bits(vli, val + i, cnt);
+		if (ret)
+			return ret;
+		if (val[i] && (ret = vli_get_bit(vli)))
+			val[i] = -val[i];
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+struct picture *legacy_decode(struct bytes_reader *bytes, int number, int pixels_max, int layers_limit)
+{
+	int channels = number == '6' ? 3 : 1;
+	int width, height;
+	if (read_bytes(bytes, &width, 2) || read_bytes(bytes, &height, 2))
+		return 0;
+	++width;
+	++height;
+	if (width < LEGACY_MIN_LEN || height < LEGACY_MIN_LEN)
+		return 0;
+	int levels = compute_levels(width, height, LEGACY_MIN_LEN);
+	int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+	compute_lengths(lengths, pixels, widths, heights, width, height, levels);
+	int levels_max = levels;
+	if (pixels_max >= 0)
+		while (levels_max > 0 && pixels[levels_max] > pixels_max)
+			--levels_max;
+	int total = pixels[levels_max];
+	int *buffers[3] = { 0 };
+	for (int chan = 0; chan < channels; ++chan)
+		buffers[chan] = calloc(total, sizeof(int));
+	struct bits_reader *bits = bits_reader(bytes);
+	struct vli_reader *vli = vli_reader(bits);
+	struct rle_reader *rle = rle_reader(vli);
+	struct picture *picture = 0;
+	int planes[3], missing[3 * MAX_LEVELS];
+	for (int chan = 0; chan < channels; ++chan)
+		if (legacy_decode_root(vli, buffers[chan], pixels[0]))
+			goto end;
+	for (int chan = 0; chan < channels; ++chan)
+		if ((planes[chan] = get_vli(vli)) < 0 || planes[chan] > (int)sizeof(int) * 8 - 3)
+			goto end;
+	int planes_max = 0;
+	for (int chan = 0; chan < channels; ++chan)
+		if (planes_max < planes[chan])
+			planes_max = planes[chan];
+	int maximum = levels > planes_max ? levels : planes_max;
+	int layers_max = 2 * maximum - 1;
+	for (int chan = 0; chan < channels; ++chan)
+		for (int l = 0; l < levels; ++l)
+			missing[chan * MAX_LEVELS + l] = planes[chan];
+	int level = -1;
+	if (!levels_max)
+		goto done;
+	if (planes_max == planes[0]) {
+		level = 0;
+		if (legacy_decode_plane(rle, buffers[0] + pixels[0], pixels[1] - pixels[0], planes[0] - 1))
+			goto done;
+		--missing[0];
+	}
+	for (int layers = 0; layers < layers_max && layers != layers_limit; ++layers) {
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers + 1; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			if (l >= levels_max)
+				goto done;
+			int plane = planes_max - 1 - (layers + 1 - l);
+			if (plane < 0 || plane >= planes[0])
+				continue;
+			if (level < l)
+				level = l;
+			if (legacy_decode_plane(rle, buffers[0] + off, num, plane))
+				goto done;
+			--missing[l];
+		}
+		for (int l = 0, off = pixels[0],
+			num = pixels[l + 1] - pixels[l];
+			l < levels && l <= layers; off += num, ++l,
+			num = pixels[l + 1] - pixels[l]) {
+			if (l >= levels_max)
+				goto done;
+			for (int chan = 1; chan < channels; ++chan) {
+				int plane = planes_max - 1 - (layers - l);
+				if (plane < 0 || plane >= planes[chan])
+					continue;
+				if (level < l)
+					level = l;
+				if (legacy_decode_plane(rle, buffers[chan] + off, num, plane))
+					goto done;
+				--missing[chan * MAX_LEVELS + l];
+			}
+		}
+	}
+done:
+	levels = level + 1;
+	width = widths[levels];
+	height = heights[levels];
+	total = pixels[levels];
+	int *temp = malloc(sizeof(int) * total);
+	for (int chan = 0; chan < channels; ++chan) {
+		legacy_reconstruction(temp, buffers[chan], missing + chan * MAX_LEVELS, widths, heights, lengths, levels);
+		if (levels)
+			legacy_transformation(temp, buffers[chan], width, height, width);
+		int *swap = buffers[chan];
+		buffers[chan] = temp;
+		temp = swap;
+	}
+	free(temp);
+	picture = new_picture(width, height, channels);
+	for (int j = 0; j < height; ++j) {
+		int *rows[3];
+		for (int chan = 0; chan < channels; ++chan)
+			rows[chan] = buffers[chan] + width * j;
+		narrow_row(picture->buffer + (size_t)width * channels * j, rows, 1, width, channels, 0);
+	}
+end:
+	delete_rle_reader(rle);
+	delete_vli_reader(vli);
+	close_bits_reader(bits);
+	for (int chan = 0; chan < channels; ++chan)
+		free(buffers[chan]);
+	return picture;
+}
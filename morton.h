@@ -0,0 +1,25 @@
+/*
+Morton curve also known as Z-order curve
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include "hilbert.h"
+
+int morton_compact(unsigned long long d)
+{
+	d &= 0x5555555555555555ULL;
+	d = (d | d >> 1) & 0x3333333333333333ULL;
+	d = (d | d >> 2) & 0x0f0f0f0f0f0f0f0fULL;
+	d = (d | d >> 4) & 0x00ff00ff00ff00ffULL;
+	d = (d | d >> 8) & 0x0000ffff0000ffffULL;
+	d = (d | d >> 16) & 0x00000000ffffffffULL;
+	return d;
+}
+
+struct position morton(long long d)
+{
+	return (struct position) { morton_compact(d), morton_compact(d >> 1) };
+}
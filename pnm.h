@@ -9,32 +9,52 @@ Copyright 2014 Ahmet Inan <xdsopl@gmail.com>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "image.h"
 
-struct image *read_pnm(const char *name)
+int read_pam_header(FILE *file, int *integer, int *channels)
 {
-	const char *fname = "/dev/stdin";
-	if (name[0] != '-' || name[1])
-		fname = name;
-	FILE *file = fopen(fname, "r");
-	if (!file) {
-		fprintf(stderr, "could not open \"%s\" file to read.\n", fname);
-		return 0;
+	char key[16];
+	while (1 == fscanf(file, "%15s", key)) {
+		if ('#' == key[0] || !strcmp(key, "TUPLTYPE")) {
+			for (int c; '\n' != (c = fgetc(file));)
+				if (EOF == c)
+					return -1;
+		} else if (!strcmp(key, "ENDHDR")) {
+			return '\n' != fgetc(file);
+		} else {
+			int *val = 0;
+			if (!strcmp(key, "WIDTH"))
+				val = integer;
+			else if (!strcmp(key, "HEIGHT"))
+				val = integer + 1;
+			else if (!strcmp(key, "MAXVAL"))
+				val = integer + 2;
+			else if (!strcmp(key, "DEPTH"))
+				val = channels;
+			if (!val || 1 != fscanf(file, "%d", val))
+				return -1;
+		}
 	}
+	return -1;
+}
+
+struct picture *read_pnm_header(FILE *file, const char *fname)
+{
 	int letter = fgetc(file);
 	int number = fgetc(file);
-	if ('P' != letter || ('5' != number && '6' != number)) {
-		fprintf(stderr, "file \"%s\" neither P5 nor P6 image.\n", fname);
-		fclose(file);
+	if ('P' != letter || ('5' != number && '6' != number && '7' != number)) {
+		fprintf(stderr, "file \"%s\" neither P5, P6 nor P7 image.\n", fname);
 		return 0;
 	}
 	int channels = number == '5' ? 1 : 3;
-	int integer[3];
-	struct image *image = 0;
+	int integer[3] = { 0 };
 	int c = fgetc(file);
 	if (EOF == c)
 		goto eof;
-	for (int i = 0; i < 3; i++) {
+	if ('7' == number && read_pam_header(file, integer, &channels))
+		goto eof;
+	for (int i = 0; '7' != number && i < 3; i++) {
 		while ('#' == (c = fgetc(file)))
 			while ('\n' != (c = fgetc(file)))
 				if (EOF == c)
@@ -57,62 +77,87 @@ struct image *read_pnm(const char *name)
 	}
 	if (!(integer[0] && integer[1] && integer[2])) {
 		fprintf(stderr, "could not read image file \"%s\".\n", fname);
-		fclose(file);
+		return 0;
+	}
+	if (channels < 1 || channels > MAX_CHANNELS) {
+		fprintf(stderr, "cant read \"%s\", only up to %d channels supported.\n", fname, MAX_CHANNELS);
 		return 0;
 	}
 	if (integer[2] != 255) {
 		fprintf(stderr, "cant read \"%s\", only 8 bit per channel SRGB supported at the moment.\n", fname);
-		fclose(file);
 		return 0;
 	}
-	image = new_image(integer[0], integer[1], channels);
-	for (int i = 0; i < channels * image->total; i++) {
-		int v = fgetc(file);
-		if (EOF == v)
-			goto eof;
-		image->buffer[i] = v;
+	if ((long long)integer[0] * integer[1] > INT_MAX) {
+		fprintf(stderr, "cant read \"%s\", picture has more than %d pixels.\n", fname, INT_MAX);
+		return 0;
 	}
-	fclose(file);
-	return image;
+	return new_picture(integer[0], integer[1], channels);
 eof:
 	fprintf(stderr, "EOF while reading from \"%s\".\n", fname);
-	fclose(file);
-	delete_image(image);
 	return 0;
 }
 
-int clamp_pnm(int x, int a, int b)
+struct picture *read_pnm_file(FILE *file, const char *fname)
 {
-	return x < a ? a : x > b ? b : x;
+	struct picture *picture = read_pnm_header(file, fname);
+	if (!picture)
+		return 0;
+	size_t size = (size_t)picture->channels * picture->total;
+	if (size != fread(picture->buffer, 1, size, file)) {
+		fprintf(stderr, "EOF while reading from \"%s\".\n", fname);
+		delete_picture(picture);
+		return 0;
+	}
+	return picture;
 }
 
-int write_pnm(const char *name, struct image *image)
+struct picture *read_pnm(const char *name)
 {
-	int channels = image->channels;
-	assert(channels == 1 || channels == 3);
-	const char *fname = "/dev/stdout";
+	const char *fname = "/dev/stdin";
 	if (name[0] != '-' || name[1])
 		fname = name;
-	FILE *file = fopen(fname, "w");
+	FILE *file = fopen(fname, "r");
 	if (!file) {
-		fprintf(stderr, "could not open \"%s\" file to write.\n", fname);
+		fprintf(stderr, "could not open \"%s\" file to read.\n", fname);
 		return 0;
 	}
-	int number = channels == 1 ? 5 : 6;
-	if (!fprintf(file, "P%d %d %d 255\n", number, image->width, image->height)) {
+	struct picture *picture = read_pnm_file(file, fname);
+	fclose(file);
+	return picture;
+}
+
+int write_pnm_file(FILE *file, const char *fname, struct picture *picture)
+{
+	int channels = picture->channels;
+	assert(channels >= 1 && channels <= MAX_CHANNELS);
+	int ret;
+	if (channels == 1 || channels == 3)
+		ret = fprintf(file, "P%d %d %d 255\n", channels == 1 ? 5 : 6, picture->width, picture->height);
+	else
+		ret = fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nENDHDR\n", picture->width, picture->height, channels);
+	if (ret < 0) {
 		fprintf(stderr, "could not write to file \"%s\".\n", fname);
-		fclose(file);
 		return 0;
 	}
-	for (int i = 0; i < channels * image->total; i++) {
-		if (EOF == fputc(clamp_pnm(image->buffer[i], 0, 255), file))
-			goto eof;
+	size_t size = (size_t)channels * picture->total;
+	if (size != fwrite(picture->buffer, 1, size, file)) {
+		fprintf(stderr, "EOF while writing to \"%s\".\n", fname);
+		return 0;
 	}
-	fclose(file);
 	return 1;
-eof:
-	fprintf(stderr, "EOF while writing to \"%s\".\n", fname);
-	fclose(file);
-	return 0;
 }
 
+int write_pnm(const char *name, struct picture *picture)
+{
+	const char *fname = "/dev/stdout";
+	if (name[0] != '-' || name[1])
+		fname = name;
+	FILE *file = fopen(fname, "w");
+	if (!file) {
+		fprintf(stderr, "could not open \"%s\" file to write.\n", fname);
+		return 0;
+	}
+	int ret = write_pnm_file(file, fname, picture);
+	fclose(file);
+	return ret;
+}
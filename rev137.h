@@ -0,0 +1,95 @@
+/*
+Reversible integer 13/7 wavelet
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include "utils.h"
+
+static inline int predict137(int *val, int a, int b, int d, int e)
+{
+	return (9 * (val[b] + val[d]) - val[a] - val[e] + 8) >> 4;
+}
+
+static inline int update137(int *val, int a, int b, int d, int e)
+{
+	return (9 * (val[b] + val[d]) - val[a] - val[e] + 16) >> 5;
+}
+
+void rev137(int *val, int N, int S, int CH, int SC)
+{
+	if (N < 2)
+		return;
+	int i = 1;
+	for (; i < N && i < 3; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= predict137(val + c * SC, a, b, d, e);
+	}
+	for (; i < N - 3; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= predict137(val + c * SC, (i - 3) * S, (i - 1) * S, (i + 1) * S, (i + 3) * S);
+	for (; i < N; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= predict137(val + c * SC, a, b, d, e);
+	}
+	i = 0;
+	for (; i < N && i < 4; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += update137(val + c * SC, a, b, d, e);
+	}
+	for (; i < N - 3; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += update137(val + c * SC, (i - 3) * S, (i - 1) * S, (i + 1) * S, (i + 3) * S);
+	for (; i < N; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += update137(val + c * SC, a, b, d, e);
+	}
+}
+
+void irev137(int *val, int N, int S, int CH, int SC)
+{
+	if (N < 2)
+		return;
+	int i = 0;
+	for (; i < N && i < 4; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= update137(val + c * SC, a, b, d, e);
+	}
+	for (; i < N - 3; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= update137(val + c * SC, (i - 3) * S, (i - 1) * S, (i + 1) * S, (i + 3) * S);
+	for (; i < N; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] -= update137(val + c * SC, a, b, d, e);
+	}
+	i = 1;
+	for (; i < N && i < 3; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += predict137(val + c * SC, a, b, d, e);
+	}
+	for (; i < N - 3; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += predict137(val + c * SC, (i - 3) * S, (i - 1) * S, (i + 1) * S, (i + 3) * S);
+	for (; i < N; i += 2) {
+		int a = mirror(i - 3, N) * S, b = mirror(i - 1, N) * S;
+		int d = mirror(i + 1, N) * S, e = mirror(i + 3, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[i * S + c * SC] += predict137(val + c * SC, a, b, d, e);
+	}
+}
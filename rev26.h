@@ -0,0 +1,59 @@
+/*
+Reversible integer 2/6 wavelet
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include "utils.h"
+
+void rev26(int *val, int N, int S, int CH, int SC)
+{
+	int M = N & ~1;
+	for (int i = 0; i < M; i += 2) {
+		for (int c = 0; c < CH; ++c) {
+			val[(i + 1) * S + c * SC] -= val[i * S + c * SC];
+			val[i * S + c * SC] += val[(i + 1) * S + c * SC] >> 1;
+		}
+	}
+	int i = 0;
+	for (; i < M && i < 2; i += 2) {
+		int a = mirror(i - 2, N) * S, b = mirror(i + 2, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] += (val[a + c * SC] - val[b + c * SC]) >> 2;
+	}
+	for (; i < N - 2; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] += (val[(i - 2) * S + c * SC] - val[(i + 2) * S + c * SC]) >> 2;
+	for (; i < M; i += 2) {
+		int a = mirror(i - 2, N) * S, b = mirror(i + 2, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] += (val[a + c * SC] - val[b + c * SC]) >> 2;
+	}
+}
+
+void irev26(int *val, int N, int S, int CH, int SC)
+{
+	int M = N & ~1;
+	int i = 0;
+	for (; i < M && i < 2; i += 2) {
+		int a = mirror(i - 2, N) * S, b = mirror(i + 2, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] -= (val[a + c * SC] - val[b + c * SC]) >> 2;
+	}
+	for (; i < N - 2; i += 2)
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] -= (val[(i - 2) * S + c * SC] - val[(i + 2) * S + c * SC]) >> 2;
+	for (; i < M; i += 2) {
+		int a = mirror(i - 2, N) * S, b = mirror(i + 2, N) * S;
+		for (int c = 0; c < CH; ++c)
+			val[(i + 1) * S + c * SC] -= (val[a + c * SC] - val[b + c * SC]) >> 2;
+	}
+	for (i = 0; i < M; i += 2) {
+		for (int c = 0; c < CH; ++c) {
+			val[i * S + c * SC] -= val[(i + 1) * S + c * SC] >> 1;
+			val[(i + 1) * S + c * SC] += val[i * S + c * SC];
+		}
+	}
+}
@@ -36,6 +36,8 @@ struct rle_writer *rle_writer(struct vli_writer *vli)
 
 int rle_flush(struct rle_writer *rle)
 {
+	if (rle->cnt <= 0)
+		return rle->cnt;
 	return rle->cnt = put_vli(rle->vli, rle->cnt);
 }
 
@@ -102,3 +104,12 @@ int rle_get_bit(struct rle_reader *rle)
 	return vli_get_bit(rle->vli);
 }
 
+int rle_drain(struct rle_reader *rle)
+{
+	if (rle->cnt <= 0)
+		return rle->cnt;
+	int ret = get_rle(rle);
+	if (ret < 0)
+		return ret;
+	return ret != 1 ? -1 : 0;
+}
@@ -0,0 +1,42 @@
+/*
+Selection of space filling curves for the scan order
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <string.h>
+#include "hilbert.h"
+#include "morton.h"
+
+#define SCANS 2
+
+const char *scan_names[SCANS] = { "hilbert", "morton" };
+
+int scan_index(const char *name)
+{
+	for (int i = 0; i < SCANS; ++i)
+		if (!strcmp(name, scan_names[i]))
+			return i;
+	return -1;
+}
+
+struct position scan_next(int scan, int n, long long *d, int w0, int h0, int w1, int h1)
+{
+	while (1) {
+		struct position pos = scan ? morton(*d) : hilbert(n, *d);
+		if ((pos.x >= w0 || pos.y >= h0) && pos.x < w1 && pos.y < h1) {
+			*d += 1;
+			return pos;
+		}
+		long long s = 1;
+		while (2 * s <= n && !(*d % (4 * s * s))) {
+			int x = pos.x & ~(2 * s - 1), y = pos.y & ~(2 * s - 1);
+			if (x < w1 && y < h1 && (x + 2 * s > w0 || y + 2 * s > h0))
+				break;
+			s *= 2;
+		}
+		*d += s * s;
+	}
+}
@@ -0,0 +1,254 @@
+/*
+Saving and restoring the state of the decoder at layer boundaries
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+#include "entropy.h"
+#include "bits.h"
+#include "bytes.h"
+
+struct snapshot {
+	long long pos;
+	uint32_t sum;
+	int layer, acc, cnt, range, code;
+	int orders[RLE_CONTEXTS];
+	uint16_t probs[CONTEXTS];
+	int missing[MAX_CHANNELS * MAX_LEVELS];
+};
+
+struct step {
+	int chan, off, num, plane;
+};
+
+struct state {
+	char *name;
+	int memory, raw, layer, level, used;
+	long long stop;
+	size_t size;
+	int head[7];
+	int planes[MAX_CHANNELS * MAX_LEVELS];
+	struct snapshot snap;
+	int *buffers[MAX_CHANNELS];
+	unsigned char *trees[MAX_CHANNELS];
+};
+
+void clear_state(struct state *state)
+{
+	for (int chan = 0; chan < MAX_CHANNELS; ++chan) {
+		free(state->buffers[chan]);
+		free(state->trees[chan]);
+		state->buffers[chan] = 0;
+		state->trees[chan] = 0;
+	}
+}
+
+int take_snapshot(struct snapshot *snap, int layer, struct entropy_reader *ent, struct bits_reader *bits, int *missing)
+{
+	if (ent->arith && ent->arith->err)
+		return -1;
+	snap->layer = layer;
+	snap->pos = bytes_tell(bits->bytes);
+	snap->sum = bits->bytes->sum;
+	snap->acc = bits->acc;
+	snap->cnt = bits->cnt;
+	for (int i = 0; i < RLE_CONTEXTS; ++i)
+		snap->orders[i] = ent->rle[i]->vli->order;
+	if (ent->arith) {
+		snap->range = ent->arith->range;
+		snap->code = ent->arith->code;
+	}
+	memcpy(snap->probs, ent->probs, sizeof(snap->probs));
+	memcpy(snap->missing, missing, sizeof(snap->missing));
+	return 0;
+}
+
+void undo_plane(int *val, int num, int plane)
+{
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int sgn_mask = 1 << sgn_pos;
+	int sig_mask = 1 << sig_pos;
+	int ref_mask = 1 << ref_pos;
+	int mix_mask = sgn_mask | sig_mask | ref_mask;
+	for (int i = 0; i < num; ++i) {
+		if (val[i] & ref_mask && (val[i] & ~mix_mask) >> plane > 1)
+			val[i] &= ~(1 << plane);
+		else if (val[i] & (sig_mask | ref_mask))
+			val[i] = 0;
+	}
+}
+
+void keep_state(struct state *state, int *head, int *planes, int level, struct snapshot *snap, int **buffers, unsigned char **trees, int channels, int used)
+{
+	state->layer = snap->layer;
+	state->level = level;
+	state->used = used;
+	state->size = 0;
+	memcpy(state->head, head, sizeof(state->head));
+	memcpy(state->planes, planes, sizeof(int) * channels * MAX_LEVELS);
+	state->snap = *snap;
+	for (int chan = 0; chan < MAX_CHANNELS; ++chan) {
+		state->buffers[chan] = 0;
+		state->trees[chan] = 0;
+	}
+	for (int chan = 0; chan < channels; ++chan) {
+		state->buffers[chan] = malloc(sizeof(int) * used);
+		memcpy(state->buffers[chan], buffers[chan], sizeof(int) * used);
+		state->size += sizeof(int) * used;
+		if (trees[chan]) {
+			state->trees[chan] = malloc(used);
+			memcpy(state->trees[chan], trees[chan], used);
+			state->size += used;
+		}
+	}
+}
+
+int restore_state(struct state *state, int *head, int *planes, int *level, struct snapshot *snap, int **buffers, unsigned char **trees, int channels)
+{
+	if (memcmp(state->head, head, sizeof(state->head))) {
+		fprintf(stderr, "state \"%s\" does not belong to this stream\n", state->name);
+		return -1;
+	}
+	memcpy(planes, state->planes, sizeof(int) * channels * MAX_LEVELS);
+	*level = state->level;
+	*snap = state->snap;
+	for (int chan = 0; chan < channels; ++chan) {
+		memcpy(buffers[chan], state->buffers[chan], sizeof(int) * state->used);
+		if (trees[chan])
+			memcpy(trees[chan], state->trees[chan], state->used);
+	}
+	return 0;
+}
+
+int save_state(char *name, int *head, int *planes, int level, struct snapshot *snap, int **buffers, unsigned char **trees, int channels, int used)
+{
+	struct bytes_writer *bytes = bytes_writer(name, 0);
+	if (!bytes)
+		return -1;
+	put_byte(bytes, 'W');
+	put_byte(bytes, 'R');
+	for (int i = 0; i < 7; ++i)
+		write_bytes(bytes, head[i], 4);
+	for (int i = 0; i < channels * MAX_LEVELS; ++i)
+		write_bytes(bytes, planes[i], 4);
+	write_bytes(bytes, level, 4);
+	write_bytes(bytes, snap->pos, 8);
+	write_bytes(bytes, snap->sum, 4);
+	int fields[5] = { snap->layer, snap->acc, snap->cnt, snap->range, snap->code };
+	for (int i = 0; i < 5; ++i)
+		write_bytes(bytes, fields[i], 4);
+	for (int i = 0; i < RLE_CONTEXTS; ++i)
+		put_byte(bytes, snap->orders[i]);
+	for (int i = 0; i < CONTEXTS; ++i)
+		write_bytes(bytes, snap->probs[i], 2);
+	for (int i = 0; i < MAX_CHANNELS * MAX_LEVELS; ++i)
+		write_bytes(bytes, snap->missing[i], 4);
+	for (int chan = 0; chan < channels; ++chan)
+		for (int i = 0; i < used; ++i)
+			write_bytes(bytes, buffers[chan][i], 4);
+	int ret = 0;
+	for (int chan = 0; trees[chan] && chan < channels; ++chan)
+		for (int i = 0; !ret && i < used; ++i)
+			ret = put_byte(bytes, trees[chan][i]);
+	close_bytes_writer(bytes);
+	return ret;
+}
+
+int load_state(FILE *file, char *name, int *head, int *planes, int *level, struct snapshot *snap, int **buffers, unsigned char **trees, int channels, int *pixels)
+{
+	struct bytes_reader state = { file, name, BYTES_SUM };
+	struct bytes_reader *bytes = &state;
+	if (get_byte(bytes) != 'W' || get_byte(bytes) != 'R')
+		return -1;
+	for (int i = 0; i < 7; ++i) {
+		int val;
+		if (read_bytes(bytes, &val, 4))
+			return -1;
+		if (val != head[i]) {
+			fprintf(stderr, "state \"%s\" does not belong to this stream\n", name);
+			return -1;
+		}
+	}
+	int levels = head[6], planes_max = 0;
+	for (int chan = 0; chan < channels; ++chan) {
+		for (int l = 0; l < MAX_LEVELS; ++l) {
+			int *plns = planes + chan * MAX_LEVELS + l;
+			if (read_bytes(bytes, plns, 4) || *plns < 0 || *plns > (int)sizeof(int) * 8 - 3 || (l >= levels && *plns))
+				return -1;
+			if (planes_max < *plns)
+				planes_max = *plns;
+		}
+	}
+	int maximum = levels > planes_max ? levels : planes_max;
+	if (read_bytes(bytes, level, 4) || *level < -1 || *level >= levels)
+		return -1;
+	int used = pixels[*level + 1];
+	long long pos;
+	int sum;
+	if (read_long_bytes(bytes, &pos, 8) || pos < 0 || read_bytes(bytes, &sum, 4))
+		return -1;
+	int fields[5];
+	for (int i = 0; i < 5; ++i)
+		if (read_bytes(bytes, fields + i, 4))
+			return -1;
+	*snap = (struct snapshot){ pos, sum, fields[0], fields[1], fields[2], fields[3], fields[4], { 0 }, { 0 }, { 0 } };
+	if (snap->layer < -1 || snap->layer > 2 * maximum - 1 || snap->cnt < 0 || snap->cnt > 8 || snap->acc < 0 || snap->acc >> snap->cnt)
+		return -1;
+	if (head[4] & 1 && ((uint32_t)snap->range < ARITH_TOP || (uint32_t)snap->code >= (uint32_t)snap->range))
+		return -1;
+	for (int i = 0; i < RLE_CONTEXTS; ++i) {
+		int order = get_byte(bytes);
+		if (order < 0 || order >= 30)
+			return -1;
+		snap->orders[i] = order;
+	}
+	for (int i = 0; i < CONTEXTS; ++i) {
+		int prob;
+		if (read_bytes(bytes, &prob, 2) || prob <= 0 || prob >= ARITH_ONE)
+			return -1;
+		snap->probs[i] = prob;
+	}
+	for (int chan = 0; chan < MAX_CHANNELS; ++chan) {
+		for (int l = 0; l < MAX_LEVELS; ++l) {
+			int *miss = snap->missing + chan * MAX_LEVELS + l;
+			if (read_bytes(bytes, miss, 4))
+				return -1;
+			if (chan >= channels || l >= levels)
+				*miss = 0;
+			else if (*miss < 0 || *miss > planes[chan * MAX_LEVELS + l])
+				return -1;
+		}
+	}
+	int int_bits = sizeof(int) * 8;
+	int sgn_pos = int_bits - 1;
+	int sig_pos = int_bits - 2;
+	int ref_pos = int_bits - 3;
+	int mix_mask = 1 << sgn_pos | 1 << sig_pos | 1 << ref_pos;
+	for (int chan = 0; chan < channels; ++chan) {
+		for (int l = 0, i = 0; i < used; ++i) {
+			if (read_bytes(bytes, buffers[chan] + i, 4))
+				return -1;
+			while (i >= pixels[l])
+				++l;
+			if (l && (buffers[chan][i] & ~mix_mask) >> planes[chan * MAX_LEVELS + l - 1])
+				return -1;
+		}
+	}
+	for (int chan = 0; trees[chan] && chan < channels; ++chan) {
+		for (int i = 0; i < used; ++i) {
+			int b = get_byte(bytes);
+			if (b < 0)
+				return -1;
+			trees[chan][i] = b;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+Read the rows of a picture in stripes with a helper thread
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <pthread.h>
+#include "image.h"
+
+#define STRIPE_ROWS 64
+
+struct stripe_reader {
+	FILE *file;
+	const char *name;
+	struct picture *picture;
+	int rows, err;
+	pthread_t reader;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+void *stripe_reader_loop(void *data)
+{
+	struct stripe_reader *stripes = data;
+	struct picture *picture = stripes->picture;
+	size_t row = (size_t)picture->channels * picture->width;
+	for (int y = 0, err = 0; !err && y < picture->height; y += STRIPE_ROWS) {
+		int num = picture->height - y < STRIPE_ROWS ? picture->height - y : STRIPE_ROWS;
+		err = row * num != fread(picture->buffer + row * y, 1, row * num, stripes->file);
+		pthread_mutex_lock(&stripes->mutex);
+		if (err)
+			stripes->err = 1;
+		else
+			stripes->rows = y + num;
+		pthread_cond_signal(&stripes->cond);
+		pthread_mutex_unlock(&stripes->mutex);
+	}
+	return 0;
+}
+
+struct stripe_reader *stripe_reader(FILE *file, const char *name, struct picture *picture)
+{
+	struct stripe_reader *stripes = malloc(sizeof(struct stripe_reader));
+	stripes->file = file;
+	stripes->name = name;
+	stripes->picture = picture;
+	stripes->rows = 0;
+	stripes->err = 0;
+	pthread_mutex_init(&stripes->mutex, 0);
+	pthread_cond_init(&stripes->cond, 0);
+	if (pthread_create(&stripes->reader, 0, stripe_reader_loop, stripes)) {
+		fprintf(stderr, "could not start reader thread for file \"%s\"\n", name);
+		pthread_mutex_destroy(&stripes->mutex);
+		pthread_cond_destroy(&stripes->cond);
+		free(stripes);
+		return 0;
+	}
+	return stripes;
+}
+
+int wait_stripe(struct stripe_reader *stripes, int rows)
+{
+	pthread_mutex_lock(&stripes->mutex);
+	while (stripes->rows < rows && !stripes->err)
+		pthread_cond_wait(&stripes->cond, &stripes->mutex);
+	int err = stripes->rows < rows;
+	pthread_mutex_unlock(&stripes->mutex);
+	if (err) {
+		fprintf(stderr, "EOF while reading from \"%s\".\n", stripes->name);
+		return -1;
+	}
+	return 0;
+}
+
+void delete_stripe_reader(struct stripe_reader *stripes)
+{
+	pthread_join(stripes->reader, 0);
+	pthread_mutex_destroy(&stripes->mutex);
+	pthread_cond_destroy(&stripes->cond);
+	free(stripes);
+}
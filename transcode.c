@@ -0,0 +1,126 @@
+/*
+Transcoder reducing the resolution and size of encoded pictures without transformation
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#define _DEFAULT_SOURCE
+#include "encoder.h"
+#include "decoder.h"
+#include "layout.h"
+#include "bytes.h"
+
+int output_planes(int *planes, int channels, int levels, int layers)
+{
+	int reach = layers < levels ? layers + 1 : levels, planes_max = 0;
+	for (int chan = 0; chan < channels; ++chan)
+		for (int l = 0; l < reach; ++l)
+			if (planes_max < planes[chan * MAX_LEVELS + l])
+				planes_max = planes[chan * MAX_LEVELS + l];
+	return planes_max;
+}
+
+int transcode(char *input, char *output, int pixels_max, long long capacity, int budget)
+{
+	struct bytes_reader *bytes = bytes_reader(input);
+	if (!bytes)
+		return 1;
+	int number = get_byte(bytes) == 'W' ? get_byte(bytes) : -1;
+	if (number == 'S') {
+		fprintf(stderr, "can not transcode image sequences\n");
+		close_bytes_reader(bytes);
+		return 1;
+	}
+	struct state state = { 0 };
+	state.name = input;
+	state.memory = 1;
+	state.raw = 1;
+	int limit = budget ? budget : -1, levels = 0, done = 0, ret = 1;
+	long long kib = 0;
+	state.stop = capacity;
+	while (!done) {
+		int *buffers[MAX_CHANNELS], head[7], level;
+		struct state old = state;
+		if (bytes_seek(bytes, 2, SEEK_SET) || decode_coefficients(bytes, number, 0, -1, limit, &state, buffers, head, &level))
+			goto end;
+		if (state.buffers[0] != old.buffers[0])
+			clear_state(&old);
+		int channels = head[1], mode = head[4], wavelet = head[5];
+		int lengths[MAX_LEVELS + 1], pixels[MAX_LEVELS + 1], widths[MAX_LEVELS + 1], heights[MAX_LEVELS + 1];
+		compute_lengths(lengths, pixels, widths, heights, head[2], head[3], head[6]);
+		int planes_max = 0;
+		for (int chan = 0; chan < channels; ++chan)
+			for (int l = 0; l < head[6]; ++l)
+				if (planes_max < state.planes[chan * MAX_LEVELS + l])
+					planes_max = state.planes[chan * MAX_LEVELS + l];
+		int maximum = head[6] > planes_max ? head[6] : planes_max;
+		levels = head[6];
+		while (levels > 0 && pixels_max >= 0 && pixels[levels] > pixels_max)
+			--levels;
+		if (!levels) {
+			fprintf(stderr, "no decomposition level left to transcode\n");
+			done = -1;
+		}
+		int layer = state.layer, exact = 0, whole = 0;
+		for (int layers = 1; levels && (!budget || layers <= budget); ++layers) {
+			int planes_out = output_planes(state.planes, channels, levels, layers);
+			int maximum_out = levels > planes_out ? levels : planes_out;
+			if (layers > 2 * maximum_out - 1)
+				break;
+			whole = layers;
+			if (layers + planes_max - planes_out <= layer)
+				exact = layers;
+		}
+		int first = 1 + planes_max - output_planes(state.planes, channels, levels, 1);
+		int stopped = state.stop && state.snap.pos >= state.stop;
+		int final = layer >= 2 * maximum - 1 || exact == whole || ((limit < 0 || layer < limit) && !stopped);
+		if (!done && (final || (capacity && layer >= first))) {
+			struct bytes_writer *out = bytes_writer(output, capacity);
+			if (out) {
+				int cut = layer >= 2 * maximum - 1 ? whole : exact > 0 ? exact : 1;
+				done = encode(out, 0, buffers, widths[levels], heights[levels], channels, 0, mode, wavelet, levels, final ? cut : exact, final ? cut : budget, state.planes) || final;
+				long long count = bytes_count(out);
+				kib = (count + 512) / 1024;
+				state.stop = state.snap.pos + 1 + (long long)((double)(capacity - count) * state.snap.pos / (count ? count : 1));
+				close_bytes_writer(out);
+			} else {
+				done = -1;
+			}
+		}
+		for (int chan = 0; chan < channels; ++chan)
+			free(buffers[chan]);
+		limit = whole + planes_max - output_planes(state.planes, channels, levels, whole);
+		if (layer < first) {
+			limit = first;
+			state.stop = 0;
+		}
+	}
+	if (done > 0) {
+		fprintf(stderr, "%d levels (%lld KiB) transcoded\n", levels, kib);
+		ret = 0;
+	}
+end:
+	close_bytes_reader(bytes);
+	clear_state(&state);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	char *prog = argv[0];
+	int budget = 0;
+	for (; argc > 1 && argv[1][0] == '-' && argv[1][1]; --argc, ++argv) {
+		if (!strcmp(argv[1], "-b") && argc > 2 && (budget = atoi(argv[2])) > 0)
+			--argc, ++argv;
+		else
+			goto usage;
+	}
+	if (argc < 3 || argc > 5) {
+usage:
+		fprintf(stderr, "usage: %s [-b LAYERS] input.dwt output.dwt [PIXELS] [CAPACITY]\n", prog);
+		return 1;
+	}
+	int pixels_max = argc >= 4 ? atoi(argv[3]) : -1;
+	long long capacity = argc >= 5 ? atoll(argv[4]) : 0;
+	return transcode(argv[1], argv[2], pixels_max, capacity, budget);
+}
@@ -0,0 +1,55 @@
+/*
+Parent-child relationship between coefficients of neighboring levels
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include "scan.h"
+
+int parent_helper(int x, int *widths, int l)
+{
+	if (x < widths[l])
+		return x / 2;
+	int off = (x - widths[l]) / 2;
+	int max = widths[l] - widths[l - 1] - 1;
+	return widths[l - 1] + (off < max ? off : max);
+}
+
+void compute_parents(int *parents, int *widths, int *heights, int *lengths, int levels, int scan)
+{
+	int width = widths[levels];
+	int *index = malloc(sizeof(int) * width * heights[levels]);
+	int *position = malloc(sizeof(int) * width * heights[levels]);
+	int count = 0;
+	for (int y = 0; y < heights[0]; ++y) {
+		for (int x = 0; x < widths[0]; ++x) {
+			position[count] = width * y + x;
+			index[width * y + x] = count++;
+		}
+	}
+	for (int l = 0; l < levels; ++l) {
+		long long d = 0;
+		for (int end = widths[l + 1] * heights[l + 1]; count < end;) {
+			struct position pos = scan_next(scan, lengths[l + 1], &d, widths[l], heights[l], widths[l + 1], heights[l + 1]);
+			position[count] = width * pos.y + pos.x;
+			index[width * pos.y + pos.x] = count++;
+		}
+	}
+	int i = 0;
+	for (int end = widths[1] * heights[1]; i < end; ++i)
+		parents[i] = -1;
+	for (int l = 1; l < levels; ++l) {
+		for (int end = widths[l + 1] * heights[l + 1]; i < end; ++i) {
+			int x = position[i] % width;
+			int y = position[i] / width;
+			int px = parent_helper(x, widths, l);
+			int py = parent_helper(y, heights, l);
+			parents[i] = index[width * py + px];
+		}
+	}
+	free(index);
+	free(position);
+}
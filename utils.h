@@ -6,6 +6,12 @@ Copyright 2021 Ahmet Inan <xdsopl@gmail.com>
 
 #pragma once
 
+#include <stdlib.h>
+#include <limits.h>
+
+#define MAX_LEVELS 16
+#define LAYOUT_VERSION 1
+
 int ilog2(int x)
 {
 	int l = -1;
@@ -14,28 +20,56 @@ int ilog2(int x)
 	return l;
 }
 
-int lengths_helper(int *pixels, int *widths, int *heights, int W, int H, int N0)
+int valid_size(int width, int height)
+{
+	return width > 0 && height > 0 && width <= 1 << 30 && height <= 1 << 30 && (long long)width * height <= INT_MAX;
+}
+
+int median_predictor(int *val, int x, int y, int SW, int CH)
+{
+	int *cur = val + (SW * y + x) * CH;
+	if (!y)
+		return x ? cur[-CH] : 0;
+	if (!x)
+		return cur[-SW * CH];
+	int a = cur[-CH], b = cur[-SW * CH], c = cur[-(SW + 1) * CH];
+	int min = a < b ? a : b, max = a < b ? b : a;
+	if (c >= max)
+		return min;
+	if (c <= min)
+		return max;
+	return a + b - c;
+}
+
+int mirror(int i, int N)
 {
-	int level = 0, W2 = (W + 1) / 2, H2 = (H + 1) / 2;
-	if (W2 >= N0 && H2 >= N0)
-		level = lengths_helper(pixels, widths, heights, W2, H2, N0);
-	widths[level] = W2;
-	heights[level] = H2;
-	pixels[level] = W2 * H2;
-	return level + 1;
+	if (N < 2)
+		return 0;
+	int P = 2 * (N - 1);
+	i = abs(i) % P;
+	return i < N ? i : P - i;
 }
 
-int compute_lengths(int *lengths, int *pixels, int *widths, int *heights, int W, int H, int N0)
+int compute_levels(int W, int H, int N0)
+{
+	int levels = 1;
+	for (W = (W + 1) / 2, H = (H + 1) / 2; levels < MAX_LEVELS && W >= N0 && H >= N0 && W * H > 1; ++levels)
+		W = (W + 1) / 2, H = (H + 1) / 2;
+	return levels;
+}
+
+void compute_lengths(int *lengths, int *pixels, int *widths, int *heights, int W, int H, int levels)
 {
-	int levels = lengths_helper(pixels, widths, heights, W, H, N0);
 	widths[levels] = W;
 	heights[levels] = H;
-	pixels[levels] = W * H;
+	for (int l = levels; l > 0; --l) {
+		widths[l - 1] = (widths[l] + 1) / 2;
+		heights[l - 1] = (heights[l] + 1) / 2;
+	}
 	for (int l = 0; l <= levels; ++l) {
+		pixels[l] = widths[l] * heights[l];
 		int w = 1 << (ilog2(widths[l] - 1) + 1);
 		int h = 1 << (ilog2(heights[l] - 1) + 1);
 		lengths[l] = w > h ? w : h;
 	}
-	return levels;
 }
-
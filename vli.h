@@ -87,6 +87,8 @@ int get_vli(struct vli_reader *vli)
 {
 	int val, sum = 0, ret;
 	while ((ret = get_bit(vli->bits)) == 0) {
+		if (vli->order >= 30)
+			return -1;
 		sum += 1 << vli->order;
 		vli->order += 1;
 	}
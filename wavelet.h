@@ -0,0 +1,82 @@
+/*
+Selection of reversible integer wavelets
+
+Copyright 2026 Ahmet Inan <xdsopl@gmail.com>
+*/
+
+#pragma once
+
+#include <string.h>
+#include "cdf53.h"
+#include "haar.h"
+#include "rev26.h"
+#include "rev137.h"
+
+#define WAVELETS 4
+
+#ifdef GENERIC
+#define KERNELS(name) { name, name, name }
+#define BAND_THREADS 0
+#else
+#define KERNELS(name) { name##_row, name##_col, name }
+#define BAND_THREADS 1
+#endif
+
+#define SPECIALIZE(name) \
+void name##_row(int *val, int N, int S, int CH, int SC) \
+{ \
+	(void)CH; \
+	(void)SC; \
+	name(val, N, S, 1, 1); \
+} \
+\
+void name##_col(int *val, int N, int S, int CH, int SC) \
+{ \
+	(void)SC; \
+	name(val, N, S, CH, 1); \
+}
+
+SPECIALIZE(cdf53)
+SPECIALIZE(icdf53)
+SPECIALIZE(haar)
+SPECIALIZE(ihaar)
+SPECIALIZE(rev26)
+SPECIALIZE(irev26)
+SPECIALIZE(rev137)
+SPECIALIZE(irev137)
+
+struct wavelet {
+	void (*row)(int *, int, int, int, int);
+	void (*col)(int *, int, int, int, int);
+	void (*any)(int *, int, int, int, int);
+};
+
+const char *wavelet_names[WAVELETS] = { "53", "haar", "26", "137" };
+struct wavelet wavelets[WAVELETS] = {
+	KERNELS(cdf53),
+	KERNELS(haar),
+	KERNELS(rev26),
+	KERNELS(rev137),
+};
+struct wavelet inverse_wavelets[WAVELETS] = {
+	KERNELS(icdf53),
+	KERNELS(ihaar),
+	KERNELS(irev26),
+	KERNELS(irev137),
+};
+
+void wavelet_columns(struct wavelet *wavelet, int *val, int N, int S, int CH, int SC)
+{
+	if (SC == 1)
+		wavelet->col(val, N, S, CH, 1);
+	else
+		wavelet->any(val, N, S, CH, SC);
+}
+
+int wavelet_index(const char *name)
+{
+	for (int i = 0; i < WAVELETS; ++i)
+		if (!strcmp(name, wavelet_names[i]))
+			return i;
+	return -1;
+}